@@ -0,0 +1,82 @@
+#include "admission.h"
+#include "process.h"
+#include <chrono>
+
+void AdmissionController::configure(const AdmissionConfig& cfg) {
+    config = cfg;
+}
+
+bool AdmissionController::tryAdmit(Process* p, std::string* reason) {
+    uint64_t live = resident_processes.fetch_add(1);
+    if (config.max_queue_depth > 0 && live >= config.max_queue_depth) {
+        resident_processes--;
+        if (reason) *reason = "process limit reached (" + std::to_string(live) + " live)";
+        return false;
+    }
+
+    uint64_t bytes = p->estimateFootprint();
+    uint64_t before = resident_bytes.fetch_add(bytes);
+    // A process larger than the whole budget still runs, but only alone
+    if (config.max_resident_bytes > 0 && before > 0 && before + bytes > config.max_resident_bytes) {
+        resident_bytes -= bytes;
+        resident_processes--;
+        if (reason) {
+            *reason = "memory limit reached (" + std::to_string(before) + " of "
+                + std::to_string(config.max_resident_bytes) + " bytes resident)";
+        }
+        return false;
+    }
+    p->admitted_bytes = bytes;
+    admitted++;
+    return true;
+}
+
+void AdmissionController::charge(Process* p) {
+    p->admitted_bytes = p->estimateFootprint();
+    resident_bytes += p->admitted_bytes;
+    resident_processes++;
+}
+
+void AdmissionController::release(Process* p) {
+    resident_bytes -= p->admitted_bytes;
+    p->admitted_bytes = 0;
+    resident_processes--;
+    notifyRoom();
+}
+
+void AdmissionController::cancel(Process* p) {
+    release(p);
+    admitted--;
+}
+
+void AdmissionController::waitForRoom(const std::atomic<bool>* stop) {
+    // Bounded wait: a missed notification costs at most one period
+    std::unique_lock<std::mutex> lock(room_mutex);
+    if (stop && *stop) return;
+    waiters++;
+    room.wait_for(lock, std::chrono::milliseconds(10));
+    waiters--;
+}
+
+void AdmissionController::notifyRoom() {
+    if (waiters.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(room_mutex);
+        room.notify_all();
+    }
+}
+
+void AdmissionController::recordDeferred(uint64_t ns) {
+    deferred++;
+    wait_ns += ns;
+}
+
+AdmissionStats AdmissionController::getStats() const {
+    AdmissionStats stats;
+    stats.admitted = admitted;
+    stats.deferred = deferred;
+    stats.rejected = rejected;
+    stats.resident_bytes = resident_bytes;
+    stats.resident_processes = resident_processes;
+    stats.wait_ns = wait_ns;
+    return stats;
+}
@@ -0,0 +1,70 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+class Process;
+
+struct AdmissionConfig {
+    uint64_t max_queue_depth = 0;       // live (queued, running, blocked) processes; 0: unlimited
+    uint64_t max_resident_bytes = 0;    // live (waiting + running) processes; 0: unlimited
+    std::string policy = "throttle";    // generator at a limit: "throttle" waits, "shed" drops
+};
+
+struct AdmissionStats {
+    uint64_t admitted = 0;
+    uint64_t deferred = 0;          // arrivals that had to wait for room
+    uint64_t rejected = 0;          // refused outright (console, shed, control socket)
+    uint64_t resident_bytes = 0;
+    uint64_t resident_processes = 0;
+    uint64_t wait_ns = 0;           // total time deferred arrivals waited
+};
+
+// Bounds how much work the scheduler accepts. Every live process holds one
+// of max_queue_depth slots and is charged for its memory until it finishes
+// or migrates away, so preempted and I/O-requeued processes stay counted.
+// Slots are reserved with an atomic counter, so concurrent submitters
+// cannot overshoot the limit.
+class AdmissionController {
+public:
+    void configure(const AdmissionConfig& config);
+    const AdmissionConfig& getConfig() const { return config; }
+    bool throttles() const { return config.policy != "shed"; }
+
+    // Reserves a slot, charges p and returns true if both limits allow
+    // it, otherwise sets reason (when given) and returns false. Callers that
+    // give up on the process count it with recordRejected.
+    bool tryAdmit(Process* p, std::string* reason = nullptr);
+    // Charges p without checking limits (processes admitted elsewhere)
+    void charge(Process* p);
+    void release(Process* p);
+    // Undoes tryAdmit for a process that was not added after all
+    void cancel(Process* p);
+
+    // Throttling: waits until room may have appeared, or stop is set
+    void waitForRoom(const std::atomic<bool>* stop);
+    void notifyRoom();
+    void recordDeferred(uint64_t wait_ns);
+    void recordRejected() { rejected++; }
+
+    AdmissionStats getStats() const;
+
+private:
+    AdmissionConfig config;
+    std::atomic<uint64_t> resident_bytes{ 0 };
+    std::atomic<uint64_t> resident_processes{ 0 };
+    std::atomic<uint64_t> admitted{ 0 };
+    std::atomic<uint64_t> deferred{ 0 };
+    std::atomic<uint64_t> rejected{ 0 };
+    std::atomic<uint64_t> wait_ns{ 0 };
+
+    std::mutex room_mutex;
+    std::condition_variable room;
+    std::atomic<int> waiters{ 0 };
+};
+
+#endif // ADMISSION_H
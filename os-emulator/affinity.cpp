@@ -0,0 +1,328 @@
+#include "affinity.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <mutex>
+#include <thread>
+#include <set>
+#include <new>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <tuple>
+#include <cstdlib>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <filesystem>
+#endif
+
+namespace {
+    constexpr size_t PAGE_SIZE = 4096;
+
+    struct Placement {
+        std::string role;
+        std::vector<int> cpus;
+        bool pinned = false;
+        std::string error;
+        int cpu = -1;               // where the thread was running right after pinning
+        int node = -1;
+    };
+
+    std::mutex placements_mutex;
+    std::vector<Placement> placements;
+
+    // Threads check in as they start; the report lists them as "clock",
+    // "dispatcher", then "core N" or "pool N" in numeric order
+    bool reportOrder(const Placement& a, const Placement& b) {
+        auto key = [](const std::string& role) {
+            size_t space = role.find(' ');
+            int rank = role == "clock" ? 0 : role == "dispatcher" ? 1 : 2;
+            int index = space == std::string::npos ? 0 : std::atoi(role.c_str() + space + 1);
+            return std::make_tuple(rank, role.substr(0, space), index);
+        };
+        return key(a.role) < key(b.role);
+    }
+
+    // Drops the reserved CPUs from a set, unless that would leave it empty
+    std::vector<int> without(const std::vector<int>& cpus, const std::set<int>& reserved) {
+        std::vector<int> kept;
+        for (int cpu : cpus) {
+            if (!reserved.count(cpu)) kept.push_back(cpu);
+        }
+        return kept.empty() ? cpus : kept;
+    }
+
+    int currentCpu() {
+#ifdef _WIN32
+        return static_cast<int>(GetCurrentProcessorNumber());
+#elif defined(__linux__)
+        return sched_getcpu();
+#else
+        return -1;
+#endif
+    }
+
+    bool pin(const std::vector<int>& cpus, std::string& error) {
+        for (int cpu : cpus) {
+            if (cpu < 0) {
+                error = "CPU " + std::to_string(cpu) + " out of range";
+                return false;
+            }
+        }
+#ifdef _WIN32
+        DWORD_PTR mask = 0;
+        for (int cpu : cpus) {
+            if (cpu >= 64) {
+                error = "CPUs above 63 are in another processor group";
+                return false;
+            }
+            mask |= DWORD_PTR(1) << cpu;
+        }
+        if (SetThreadAffinityMask(GetCurrentThread(), mask) == 0) {
+            error = "SetThreadAffinityMask failed (" + std::to_string(GetLastError()) + ")";
+            return false;
+        }
+        return true;
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus) {
+            if (cpu >= CPU_SETSIZE) {
+                error = "CPU " + std::to_string(cpu) + " out of range";
+                return false;
+            }
+            CPU_SET(cpu, &set);
+        }
+        int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (result != 0) {
+            error = std::strerror(result);
+            return false;
+        }
+        return true;
+#else
+        error = "not supported on this platform";
+        return false;
+#endif
+    }
+}
+
+const std::vector<int>& AffinityPlan::pool(int thread) const {
+    static const std::vector<int> unpinned;
+    if (cores.empty()) return unpinned;
+    return cores[thread % cores.size()];
+}
+
+AffinityPlan planAffinity(const AffinityConfig& config, int num_cores) {
+    AffinityPlan plan;
+    plan.numa_local = config.numa_local;
+    if (config.dispatcher_cpu >= 0) {
+        plan.dispatcher = { config.dispatcher_cpu };
+    }
+
+    std::set<int> reserved;
+    if (config.isolate) {
+        if (config.clock_cpu >= 0) reserved.insert(config.clock_cpu);
+        if (config.dispatcher_cpu >= 0) reserved.insert(config.dispatcher_cpu);
+    }
+    std::vector<int> workers = without(config.worker_cpus, reserved);
+    // Isolating without a worker list: workers may use every other CPU
+    std::vector<int> shared;
+    if (workers.empty() && !reserved.empty()) {
+        for (int cpu = 0; cpu < hostCpuCount(); cpu++) {
+            shared.push_back(cpu);
+        }
+        shared = without(shared, reserved);
+    }
+
+    plan.cores.resize(num_cores);
+    for (int core = 0; core < num_cores; core++) {
+        auto it = config.core_cpus.find(core);
+        if (it != config.core_cpus.end()) {
+            plan.cores[core] = without(it->second, reserved);
+        }
+        else if (!workers.empty()) {
+            plan.cores[core] = { workers[core % workers.size()] };
+        }
+        else {
+            plan.cores[core] = shared;
+        }
+    }
+    return plan;
+}
+
+AffinityConfig shardAffinity(const AffinityConfig& config, int shard, int shards) {
+    AffinityConfig part = config;
+    size_t count = config.worker_cpus.size();
+    if (count == 0 || shards <= 1 || shard < 0) return part;
+    if (count >= static_cast<size_t>(shards)) {
+        // A contiguous slice each, sizes differing by at most one
+        size_t begin = count * shard / shards;
+        size_t end = count * (shard + 1) / shards;
+        part.worker_cpus.assign(config.worker_cpus.begin() + begin, config.worker_cpus.begin() + end);
+    }
+    else {
+        // More shards than CPUs: each shard's core 0 starts one CPU further on
+        std::rotate(part.worker_cpus.begin(), part.worker_cpus.begin() + shard % count, part.worker_cpus.end());
+    }
+    return part;
+}
+
+bool parseCpuList(const std::string& text, std::vector<int>& cpus) {
+    std::istringstream in(text);
+    std::string range;
+    std::vector<int> parsed;
+    while (std::getline(in, range, ',')) {
+        if (range.empty()) continue;
+        try {
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            // Checked before expanding, so "0-2000000000" fails fast
+            if (first < 0 || last < first || last >= hostCpuCount()) return false;
+            for (int cpu = first; cpu <= last; cpu++) {
+                parsed.push_back(cpu);
+            }
+        }
+        catch (const std::exception&) {
+            return false;
+        }
+    }
+    std::sort(parsed.begin(), parsed.end());
+    parsed.erase(std::unique(parsed.begin(), parsed.end()), parsed.end());
+    cpus = parsed;
+    return !cpus.empty();
+}
+
+std::string formatCpuList(const std::vector<int>& cpus) {
+    if (cpus.empty()) return "any";
+    std::vector<int> sorted = cpus;
+    std::sort(sorted.begin(), sorted.end());
+    std::string text;
+    for (size_t i = 0; i < sorted.size();) {
+        size_t j = i;
+        while (j + 1 < sorted.size() && sorted[j + 1] == sorted[j] + 1) j++;
+        if (!text.empty()) text += ",";
+        text += std::to_string(sorted[i]);
+        if (j > i) text += "-" + std::to_string(sorted[j]);
+        i = j + 1;
+    }
+    return text;
+}
+
+int hostCpuCount() {
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+int numaNodeCount() {
+#ifdef _WIN32
+    ULONG highest = 0;
+    return GetNumaHighestNodeNumber(&highest) ? static_cast<int>(highest) + 1 : 1;
+#else
+    std::error_code ec;
+    int nodes = 0;
+    for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.starts_with("node") && name.size() > 4 && std::isdigit(static_cast<unsigned char>(name[4]))) {
+            nodes++;
+        }
+    }
+    return std::max(nodes, 1);
+#endif
+}
+
+int numaNodeOf(int cpu) {
+    if (cpu < 0) return -1;
+#ifdef _WIN32
+    UCHAR node = 0;
+    if (cpu >= 64 || !GetNumaProcessorNode(static_cast<UCHAR>(cpu), &node)) return -1;
+    return node;
+#else
+    // The CPU's sysfs directory holds a nodeN link to its node
+    std::error_code ec;
+    std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.starts_with("node") && name.size() > 4 && std::isdigit(static_cast<unsigned char>(name[4]))) {
+            return std::stoi(name.substr(4));
+        }
+    }
+    return -1;
+#endif
+}
+
+bool pinCurrentThread(const std::string& role, const std::vector<int>& cpus) {
+    Placement placement;
+    placement.role = role;
+    placement.cpus = cpus;
+    if (!cpus.empty()) {
+        placement.pinned = pin(cpus, placement.error);
+    }
+    placement.cpu = currentCpu();
+    placement.node = numaNodeOf(placement.cpu);
+
+    std::lock_guard<std::mutex> lock(placements_mutex);
+    auto it = std::find_if(placements.begin(), placements.end(),
+        [&](const Placement& p) { return p.role == role; });
+    if (it != placements.end()) {
+        *it = placement;
+    }
+    else {
+        placements.push_back(placement);
+    }
+    return placement.pinned;
+}
+
+void* allocateLocal(size_t size) {
+    size = (size + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+#ifdef _WIN32
+    // Pages from VirtualAlloc come zeroed
+    UCHAR node = 0;
+    void* block = nullptr;
+    if (GetNumaProcessorNode(static_cast<UCHAR>(GetCurrentProcessorNumber()), &node)) {
+        block = VirtualAllocExNuma(GetCurrentProcess(), nullptr, size, MEM_RESERVE | MEM_COMMIT,
+            PAGE_READWRITE, node);
+    }
+    if (!block) {
+        block = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+    if (!block) throw std::bad_alloc();
+    return block;
+#else
+    void* block = ::operator new(size, std::align_val_t(PAGE_SIZE));
+    std::memset(block, 0, size);
+    return block;
+#endif
+}
+
+void freeLocal(void* block, size_t) {
+    if (!block) return;
+#ifdef _WIN32
+    VirtualFree(block, 0, MEM_RELEASE);
+#else
+    ::operator delete(block, std::align_val_t(PAGE_SIZE));
+#endif
+}
+
+void printAffinityReport() {
+    std::lock_guard<std::mutex> lock(placements_mutex);
+    std::sort(placements.begin(), placements.end(), reportOrder);
+    std::cout << "--------------------------------------" << std::endl;
+    std::cout << "Host CPUs: " << hostCpuCount() << "     NUMA nodes: " << numaNodeCount() << std::endl;
+    std::cout << std::left << std::setw(14) << "Thread" << std::setw(16) << "CPUs"
+        << std::right << std::setw(8) << "On CPU" << std::setw(7) << "Node" << "   Status" << std::endl;
+    for (const Placement& p : placements) {
+        std::cout << std::left << std::setw(14) << p.role << std::setw(16) << formatCpuList(p.cpus)
+            << std::right << std::setw(8) << (p.cpu >= 0 ? std::to_string(p.cpu) : "?")
+            << std::setw(7) << (p.node >= 0 ? std::to_string(p.node) : "?") << "   "
+            << (p.cpus.empty() ? "unpinned" : p.pinned ? "pinned" : "failed: " + p.error) << std::endl;
+    }
+    if (placements.empty()) {
+        std::cout << "No emulator threads started." << std::endl;
+    }
+    std::cout << "--------------------------------------" << std::endl;
+}
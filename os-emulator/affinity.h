@@ -0,0 +1,62 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstddef>
+
+struct AffinityConfig {
+    std::vector<int> worker_cpus;               // one host CPU per emulated core, round-robin
+    std::map<int, std::vector<int>> core_cpus;  // a whole CPU set for one core; overrides worker_cpus
+    int clock_cpu = -1;                         // -1: unpinned
+    int dispatcher_cpu = -1;
+    bool isolate = true;        // keep workers off the clock and dispatcher CPUs
+    bool numa_local = true;     // per-core state allocated by each pinned worker
+
+    bool pinned() const {
+        return !worker_cpus.empty() || !core_cpus.empty() || clock_cpu >= 0 || dispatcher_cpu >= 0;
+    }
+};
+
+// Host CPU sets per thread; an empty set leaves that thread unpinned
+struct AffinityPlan {
+    std::vector<std::vector<int>> cores;
+    std::vector<int> dispatcher;
+    bool numa_local = true;
+
+    // M:N pool threads are not tied to one core; thread i takes core i's set
+    const std::vector<int>& pool(int thread) const;
+};
+
+AffinityPlan planAffinity(const AffinityConfig& config, int num_cores);
+
+// Sharded mode: shard i of n gets the i-th slice of worker_cpus (or, with
+// fewer CPUs than shards, the list rotated by i) so shards do not pin their
+// cores onto the same CPUs. Explicit core-cpus sets and the clock and
+// dispatcher CPUs are kept as configured.
+AffinityConfig shardAffinity(const AffinityConfig& config, int shard, int shards);
+
+// CPU lists as in /sys and taskset, e.g. "0-3,8,10-11". Fails on CPUs the
+// host does not have.
+bool parseCpuList(const std::string& text, std::vector<int>& cpus);
+std::string formatCpuList(const std::vector<int>& cpus);
+
+int hostCpuCount();
+int numaNodeCount();
+int numaNodeOf(int cpu);        // -1 where the platform does not say
+
+// Pins the calling thread and records the outcome for the affinity report
+// under role, e.g. "core 3". An empty set is recorded as unpinned.
+bool pinCurrentThread(const std::string& role, const std::vector<int>& cpus);
+
+// Page-aligned, zeroed memory on the NUMA node the calling thread runs on.
+// Call it after pinning: on Linux the zeroing is the first touch that
+// places the pages.
+void* allocateLocal(size_t size);
+void freeLocal(void* block, size_t size);
+
+// Every thread pinned so far, with the CPU and node it ended up on
+void printAffinityReport();
+
+#endif // AFFINITY_H
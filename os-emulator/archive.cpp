@@ -0,0 +1,277 @@
+#include "archive.h"
+#include "process.h"
+#include "ipc.h"
+#include <cstring>
+#include <algorithm>
+
+namespace {
+    constexpr char BLOCK_MAGIC[4] = { 'C', 'S', 'A', 'R' };
+
+    struct ArchiveBlockHeader {
+        char magic[4];
+        uint32_t raw_size;
+        uint32_t compressed_size;
+        uint32_t checksum;          // FNV-1a of the compressed bytes
+    };
+
+    uint32_t fnv1a(const char* data, size_t size) {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+        }
+        return hash;
+    }
+
+    // Byte-oriented LZ77. Each sequence is
+    //
+    //   token (literal length << 4 | match length - 4), literal length
+    //   extension, literals, 16-bit match offset, match length extension
+    //
+    // where a nibble of 15 continues in bytes of 255 plus a final byte
+    // below 255. The last sequence has literals only. Log lines repeat
+    // their timestamp, core and message text, which this catches well.
+    constexpr size_t MIN_MATCH = 4;
+    constexpr size_t MAX_OFFSET = 65535;
+    constexpr int HASH_BITS = 12;
+
+    uint32_t read32(const char* p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    void putLength(std::string& out, size_t length) {
+        while (length >= 255) {
+            out += static_cast<char>(255);
+            length -= 255;
+        }
+        out += static_cast<char>(length);
+    }
+
+    void putSequence(std::string& out, const char* literals, size_t literal_length, size_t match_length,
+        size_t offset)
+    {
+        size_t match_code = match_length >= MIN_MATCH ? match_length - MIN_MATCH : 0;
+        out += static_cast<char>((std::min<size_t>(literal_length, 15) << 4) | std::min<size_t>(match_code, 15));
+        if (literal_length >= 15) putLength(out, literal_length - 15);
+        out.append(literals, literal_length);
+        if (match_length == 0) return;
+        out += static_cast<char>(offset & 0xff);
+        out += static_cast<char>(offset >> 8);
+        if (match_code >= 15) putLength(out, match_code - 15);
+    }
+
+    std::string lzCompress(const std::string& in) {
+        std::string out;
+        out.reserve(in.size() / 2);
+        std::vector<int64_t> table(size_t(1) << HASH_BITS, -1);
+        const char* data = in.data();
+        size_t n = in.size();
+        size_t anchor = 0;
+        size_t i = 0;
+        while (i + MIN_MATCH <= n) {
+            uint32_t value = read32(data + i);
+            uint32_t hash = (value * 2654435761u) >> (32 - HASH_BITS);
+            int64_t candidate = table[hash];
+            table[hash] = static_cast<int64_t>(i);
+            if (candidate < 0 || i - candidate > MAX_OFFSET || read32(data + candidate) != value) {
+                i++;
+                continue;
+            }
+            size_t match = MIN_MATCH;
+            while (i + match < n && data[candidate + match] == data[i + match]) {
+                match++;
+            }
+            putSequence(out, data + anchor, i - anchor, match, i - candidate);
+            i += match;
+            anchor = i;
+        }
+        putSequence(out, data + anchor, n - anchor, 0, 0);
+        return out;
+    }
+
+    bool getLength(const char* data, size_t size, size_t& pos, size_t& length) {
+        uint8_t byte;
+        do {
+            if (pos >= size) return false;
+            byte = static_cast<uint8_t>(data[pos++]);
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    bool lzDecompress(const char* data, size_t size, size_t raw_size, std::string& out) {
+        out.clear();
+        out.reserve(raw_size);
+        size_t pos = 0;
+        while (pos < size) {
+            uint8_t token = static_cast<uint8_t>(data[pos++]);
+            size_t literals = token >> 4;
+            if (literals == 15 && !getLength(data, size, pos, literals)) return false;
+            if (literals > size - pos || literals > raw_size - out.size()) return false;
+            out.append(data + pos, literals);
+            pos += literals;
+            if (pos == size) break;     // final sequence
+
+            if (size - pos < 2) return false;
+            size_t offset = static_cast<uint8_t>(data[pos]) | (static_cast<uint8_t>(data[pos + 1]) << 8);
+            pos += 2;
+            size_t match = token & 15;
+            if (match == 15 && !getLength(data, size, pos, match)) return false;
+            match += MIN_MATCH;
+            if (offset == 0 || offset > out.size() || match > raw_size - out.size()) return false;
+            // Byte by byte: the match may overlap what it is copying
+            size_t from = out.size() - offset;
+            for (size_t k = 0; k < match; k++) {
+                out += out[from + k];
+            }
+        }
+        return out.size() == raw_size;
+    }
+}
+
+bool ProcessArchive::open(const ArchiveConfig& archive_config, std::string& error) {
+    std::lock_guard<std::mutex> lock(mutex);
+    config = archive_config;
+    config.block_kb = std::max<uint64_t>(config.block_kb, 1);
+    out.open(config.file, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        error = "cannot create " + config.file;
+        return false;
+    }
+    file_size = 0;
+    block_offsets.clear();
+    locations.clear();
+    by_name.clear();
+    by_pid.clear();
+    pending.clear();
+    cached_block = UINT32_MAX;
+    cached.clear();
+    stats = {};
+    return true;
+}
+
+void ProcessArchive::close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!out.is_open()) return;
+    flushBlock();
+    out.close();
+}
+
+void ProcessArchive::append(Process* p) {
+    ByteWriter record;
+    record.putString(p->name);
+    record.put<uint32_t>(p->pid);
+    record.put<int32_t>(p->total_instructions);
+    record.put<int64_t>(p->start_time.time_since_epoch().count());
+    record.put<int64_t>(p->end_time.time_since_epoch().count());
+    record.putStrings(p->getLogMessages());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!out.is_open()) return;
+    uint32_t index = static_cast<uint32_t>(locations.size());
+    locations.push_back({ static_cast<uint32_t>(block_offsets.size()),
+        static_cast<uint32_t>(pending.size()), static_cast<uint32_t>(record.data().size()) });
+    by_name[p->name] = index;
+    by_pid[p->pid] = index;
+    pending += record.data();
+    stats.processes++;
+    stats.raw_bytes += record.data().size();
+    if (pending.size() >= config.block_kb * 1024) {
+        flushBlock();
+    }
+}
+
+void ProcessArchive::flushBlock() {
+    if (pending.empty()) return;
+    std::string compressed = lzCompress(pending);
+    ArchiveBlockHeader header;
+    std::memcpy(header.magic, BLOCK_MAGIC, sizeof(header.magic));
+    header.raw_size = static_cast<uint32_t>(pending.size());
+    header.compressed_size = static_cast<uint32_t>(compressed.size());
+    header.checksum = fnv1a(compressed.data(), compressed.size());
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(compressed.data(), compressed.size());
+    out.flush();
+
+    block_offsets.push_back(file_size);
+    file_size += sizeof(header) + compressed.size();
+    stats.blocks++;
+    pending.clear();
+}
+
+bool ProcessArchive::readRecord(uint32_t index, ArchivedProcess& record) {
+    const Location& location = locations[index];
+    const std::string* block = &pending;
+    if (location.block < block_offsets.size()) {
+        if (cached_block != location.block) {
+            std::ifstream in(config.file, std::ios::binary);
+            ArchiveBlockHeader header;
+            in.seekg(static_cast<std::streamoff>(block_offsets[location.block]));
+            if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+                || std::memcmp(header.magic, BLOCK_MAGIC, sizeof(header.magic)) != 0) {
+                return false;
+            }
+            std::string compressed(header.compressed_size, '\0');
+            if (!in.read(compressed.data(), compressed.size())
+                || fnv1a(compressed.data(), compressed.size()) != header.checksum) {
+                return false;
+            }
+            cached_block = UINT32_MAX;
+            if (!lzDecompress(compressed.data(), compressed.size(), header.raw_size, cached)) {
+                return false;
+            }
+            cached_block = location.block;
+            stats.block_reads++;
+        }
+        block = &cached;
+    }
+    if (location.offset + static_cast<size_t>(location.length) > block->size()) return false;
+
+    std::string bytes = block->substr(location.offset, location.length);
+    ByteReader in(bytes);
+    record.name = in.getString();
+    record.pid = in.get<uint32_t>();
+    record.total_instructions = in.get<int32_t>();
+    record.start_time = in.get<int64_t>();
+    record.end_time = in.get<int64_t>();
+    record.logs = in.getStrings();
+    return in.ok();
+}
+
+bool ProcessArchive::contains(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return by_name.count(name) > 0;
+}
+
+bool ProcessArchive::find(const std::string& name, ArchivedProcess& record) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = by_name.find(name);
+    if (it == by_name.end()) return false;
+    stats.lookups++;
+    return readRecord(it->second, record);
+}
+
+bool ProcessArchive::findPid(uint32_t pid, ArchivedProcess& record) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = by_pid.find(pid);
+    if (it == by_pid.end()) return false;
+    stats.lookups++;
+    return readRecord(it->second, record);
+}
+
+ArchiveStats ProcessArchive::getStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    ArchiveStats result = stats;
+    result.file_bytes = file_size;
+    result.pending_bytes = pending.size();
+    // Hash nodes: key, value and a next pointer, plus one bucket pointer each
+    result.index_bytes = locations.capacity() * sizeof(Location)
+        + block_offsets.capacity() * sizeof(uint64_t)
+        + by_name.size() * (sizeof(std::string) + sizeof(uint32_t) + 2 * sizeof(void*))
+        + by_pid.size() * (2 * sizeof(uint32_t) + 2 * sizeof(void*));
+    for (const auto& entry : by_name) {
+        result.index_bytes += stringHeapBytes(entry.first);
+    }
+    return result;
+}
@@ -0,0 +1,88 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <fstream>
+#include <mutex>
+#include <cstdint>
+
+class Process;
+
+struct ArchiveConfig {
+    std::string file;               // archive path; empty keeps finished processes resident
+    uint64_t after_ms = 60000;      // archive processes finished at least this long ago
+    uint64_t block_kb = 64;         // uncompressed records per compressed block
+};
+
+// What is kept of a finished process once its object is freed
+struct ArchivedProcess {
+    std::string name;
+    uint32_t pid = 0;
+    int32_t total_instructions = 0;
+    int64_t start_time = 0;         // system_clock ticks
+    int64_t end_time = 0;
+    std::vector<std::string> logs;
+};
+
+struct ArchiveStats {
+    uint64_t processes = 0;
+    uint64_t blocks = 0;
+    uint64_t raw_bytes = 0;         // records written, before compression
+    uint64_t file_bytes = 0;
+    uint64_t pending_bytes = 0;     // records not yet in a block
+    uint64_t index_bytes = 0;
+    uint64_t lookups = 0;
+    uint64_t block_reads = 0;       // lookups that had to read and inflate a block
+};
+
+// Append-only archive of finished processes. Records are gathered into
+// blocks of about block_kb, LZ-compressed and appended to the file as
+//
+//   ArchiveBlockHeader, then compressed_size bytes
+//
+// An in-memory index maps names and PIDs to (block, offset), so a lookup
+// reads and inflates one block. The last block read is kept, and records
+// still waiting for a full block are served from memory. The file is
+// rewritten from scratch each run, since PIDs restart with the emulator.
+class ProcessArchive {
+public:
+    ~ProcessArchive() { close(); }
+
+    bool open(const ArchiveConfig& config, std::string& error);
+    void close();
+    bool isOpen() const { return out.is_open(); }
+    const std::string& getPath() const { return config.file; }
+
+    void append(Process* p);
+    bool contains(const std::string& name);
+    bool find(const std::string& name, ArchivedProcess& record);
+    bool findPid(uint32_t pid, ArchivedProcess& record);
+    ArchiveStats getStats();
+
+private:
+    struct Location {
+        uint32_t block;             // index into block_offsets; == its size while pending
+        uint32_t offset;            // within the uncompressed block
+        uint32_t length;
+    };
+
+    ArchiveConfig config;
+    std::mutex mutex;
+    std::ofstream out;
+    uint64_t file_size = 0;
+    std::vector<uint64_t> block_offsets;
+    std::vector<Location> locations;
+    std::unordered_map<std::string, uint32_t> by_name;
+    std::unordered_map<uint32_t, uint32_t> by_pid;
+    std::string pending;
+    uint32_t cached_block = UINT32_MAX;
+    std::string cached;
+    ArchiveStats stats;
+
+    void flushBlock();
+    bool readRecord(uint32_t index, ArchivedProcess& record);
+};
+
+#endif // ARCHIVE_H
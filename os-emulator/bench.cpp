@@ -0,0 +1,387 @@
+#include "bench.h"
+#include "process.h"
+#include "simd_engine.h"
+#include "scheduler.h"
+#include "cycle_clock.h"
+#include "lock_stats.h"
+#include <thread>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <algorithm>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+    uint64_t argOr(const std::vector<std::string>& args, size_t index, uint64_t fallback) {
+        if (index >= args.size()) return fallback;
+        try {
+            return std::stoull(args[index]);
+        }
+        catch (const std::exception&) {
+            return fallback;
+        }
+    }
+
+    double secondsSince(std::chrono::steady_clock::time_point begin) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    }
+
+    // CPU time consumed by the whole process (all threads) so far
+    double processCpuSeconds() {
+#ifdef _WIN32
+        FILETIME created, exited, kernel, user;
+        GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user);
+        auto seconds = [](const FILETIME& t) {
+            return ((static_cast<uint64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime) / 1e7;
+        };
+        return seconds(kernel) + seconds(user);
+#else
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+            + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+#endif
+    }
+
+    void printRate(const std::string& label, uint64_t instructions, double seconds) {
+        std::cout << std::left << std::setw(18) << label << std::right
+            << std::setw(14) << std::fixed << std::setprecision(0)
+            << (seconds > 0 ? instructions / seconds : 0.0) << " instructions/sec"
+            << "   (" << std::setprecision(3) << seconds * 1000.0 << " ms)" << std::endl;
+    }
+
+    // benchmark simd [processes] [instructions]
+    void benchSimd(const std::vector<std::string>& args) {
+        size_t count = argOr(args, 1, 1024);
+        int length = static_cast<int>(argOr(args, 2, 2000));
+
+        std::vector<std::unique_ptr<Process>> owned;
+        std::vector<Process*> processes;
+        for (size_t i = 0; i < count; i++) {
+            owned.push_back(std::make_unique<Process>("bench" + std::to_string(i), length,
+                InstructionMix::Arithmetic));
+            processes.push_back(owned.back().get());
+        }
+
+        // Load before the scalar run so both engines start from the same state.
+        // Loading transposes every program into lanes, so it is part of the
+        // batch engine's cost and is timed too.
+        SimdBatchEngine engine;
+        auto begin = std::chrono::steady_clock::now();
+        if (!engine.load(processes)) {
+            std::cout << "SIMD engine cannot run these programs." << std::endl;
+            return;
+        }
+        double load_seconds = secondsSince(begin);
+
+        uint64_t scalar_instructions = 0;
+        begin = std::chrono::steady_clock::now();
+        for (Process* p : processes) {
+            while (!p->executeNextInstruction(0)) {
+                scalar_instructions++;
+            }
+        }
+        double scalar_seconds = secondsSince(begin);
+
+        begin = std::chrono::steady_clock::now();
+        uint64_t simd_instructions = engine.run();
+        double simd_seconds = secondsSince(begin);
+
+        size_t mismatches = 0;
+        for (size_t l = 0; l < processes.size(); l++) {
+            for (int v = 0; v < 10; v++) {
+                std::string name = "var" + std::to_string(v);
+                if (processes[l]->getVariableValue(name) != engine.getVariable(l, name)) {
+                    mismatches++;
+                }
+            }
+        }
+
+        std::cout << "SIMD batch interpreter (" << SimdBatchEngine::instructionSet() << "), "
+            << count << " processes x " << length << " instructions" << std::endl;
+        printRate("Scalar:", scalar_instructions, scalar_seconds);
+        printRate("SIMD batch:", simd_instructions, load_seconds + simd_seconds);
+        std::cout << "  of which load: " << std::setprecision(3) << load_seconds * 1000.0 << " ms" << std::endl;
+        if (simd_seconds > 0) {
+            std::cout << "Speedup: " << std::setprecision(2) << scalar_seconds / (load_seconds + simd_seconds)
+                << "x including load, " << scalar_seconds / simd_seconds << "x run only" << std::endl;
+        }
+        std::cout << "Results match scalar interpreter: "
+            << (mismatches == 0 && simd_instructions == scalar_instructions ? "yes" : "NO")
+            << " (" << mismatches << " variable mismatches)" << std::endl;
+    }
+
+    // benchmark loops [processes] [instructions]
+    void benchLoops(const std::vector<std::string>& args) {
+        size_t count = argOr(args, 1, 256);
+        int length = static_cast<int>(argOr(args, 2, 2000));
+
+        // Identical loop-heavy programs, compiled with and without fusion
+        std::random_device rd;
+        std::vector<std::unique_ptr<Process>> plain, fused;
+        size_t plain_ops = 0, fused_ops = 0;
+        uint64_t lines = 0;
+        for (size_t i = 0; i < count; i++) {
+            std::string name = "bench" + std::to_string(i);
+            unsigned seed = rd();
+            std::mt19937 gen_plain(seed), gen_fused(seed);
+            auto plain_program = generateProgram(name, length, InstructionMix::Loops, gen_plain, false);
+            auto fused_program = generateProgram(name, length, InstructionMix::Loops, gen_fused, true);
+            plain_ops += plain_program->code.size();
+            fused_ops += fused_program->code.size();
+            lines += plain_program->source_lines;
+            plain.push_back(std::make_unique<Process>(name, plain_program));
+            fused.push_back(std::make_unique<Process>(name, fused_program));
+        }
+
+        auto runAll = [](std::vector<std::unique_ptr<Process>>& processes) {
+            auto begin = std::chrono::steady_clock::now();
+            for (auto& p : processes) {
+                while (!p->executeNextInstruction(0)) {}
+            }
+            return secondsSince(begin);
+        };
+        double plain_seconds = runAll(plain);
+        double fused_seconds = runAll(fused);
+
+        size_t mismatches = 0;
+        for (size_t i = 0; i < count; i++) {
+            for (int v = 0; v < 10; v++) {
+                std::string name = "var" + std::to_string(v);
+                if (plain[i]->getVariableValue(name) != fused[i]->getVariableValue(name)) {
+                    mismatches++;
+                }
+            }
+        }
+
+        std::cout << "Loop-heavy programs, " << count << " processes x " << length
+            << " instructions (FOR nesting up to " << MAX_LOOP_DEPTH << ")" << std::endl;
+        std::cout << "Compiled ops: " << plain_ops << " plain, " << fused_ops << " with superinstructions" << std::endl;
+        printRate("Precompiled:", lines, plain_seconds);
+        printRate("Fused:", lines, fused_seconds);
+        if (fused_seconds > 0) {
+            std::cout << "Speedup: " << std::setprecision(2) << plain_seconds / fused_seconds << "x" << std::endl;
+        }
+        std::cout << "Results match: " << (mismatches == 0 ? "yes" : "NO")
+            << " (" << mismatches << " variable mismatches)" << std::endl;
+    }
+
+    constexpr int WORKER_ROUNDS = 3;
+
+    // benchmark worker [instructions] [processes]
+    void benchWorker(const std::vector<std::string>& args) {
+        int length = static_cast<int>(argOr(args, 1, 2000000));
+        size_t count = argOr(args, 2, 1);
+
+        // One arithmetic program shared by every process, so both runs
+        // execute exactly the same statements
+        std::random_device rd;
+        std::mt19937 gen(rd());
+        std::shared_ptr<const Program> program =
+            generateProgram("bench", length, InstructionMix::Arithmetic, gen);
+
+        // One core, FCFS, no delay: the tight path of the specialized loop
+        auto run = [&](bool specialized, uint64_t& instructions) {
+            Scheduler scheduler(1);
+            scheduler.setSchedulerType("fcfs");
+            scheduler.setDelay(0);
+            scheduler.setSpecializedWorkers(specialized);
+            for (size_t i = 0; i < count; i++) {
+                scheduler.addProcess(new Process("bench" + std::to_string(i), program));
+            }
+            auto begin = std::chrono::steady_clock::now();
+            scheduler.start();
+            while (scheduler.sampleMetrics().finished < count) {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+            double seconds = secondsSince(begin);
+            instructions = scheduler.sampleMetrics().instructions;
+            scheduler.stop();
+            return seconds;
+        };
+
+        // Alternate the two loops and keep each one's best run, so neither
+        // pays alone for cold caches or a noisy moment on the host
+        uint64_t dynamic_instructions = 0, specialized_instructions = 0;
+        double dynamic_seconds = 0, specialized_seconds = 0;
+        for (int round = 0; round < WORKER_ROUNDS; round++) {
+            double seconds = run(false, dynamic_instructions);
+            dynamic_seconds = round == 0 ? seconds : std::min(dynamic_seconds, seconds);
+            seconds = run(true, specialized_instructions);
+            specialized_seconds = round == 0 ? seconds : std::min(specialized_seconds, seconds);
+        }
+
+        std::cout << "Worker loop, FCFS, delay 0, " << count << " process(es) x "
+            << program->source_lines << " instructions, best of " << WORKER_ROUNDS << " runs each" << std::endl;
+        printRate("Runtime checks:", dynamic_instructions, dynamic_seconds);
+        printRate("Specialized:", specialized_instructions, specialized_seconds);
+        if (dynamic_instructions > 0 && specialized_instructions > 0) {
+            double saved_ns = (dynamic_seconds / dynamic_instructions
+                - specialized_seconds / specialized_instructions) * 1e9;
+            std::cout << "Per-instruction overhead saved: " << std::setprecision(1) << saved_ns
+                << " ns" << std::endl;
+        }
+        if (specialized_seconds > 0) {
+            std::cout << "Speedup: " << std::setprecision(2) << dynamic_seconds / specialized_seconds << "x" << std::endl;
+        }
+    }
+
+    // benchmark locks [cores] [processes] [instructions] [quantum]
+    void benchLocks(const std::vector<std::string>& args) {
+        int cores = static_cast<int>(argOr(args, 1, std::max(4u, std::thread::hardware_concurrency())));
+        size_t count = argOr(args, 2, 64);
+        int length = static_cast<int>(argOr(args, 3, 20000));
+        uint64_t quantum = argOr(args, 4, 1000);
+        if (!lock_stats_enabled) {
+            std::cout << "Lock statistics were compiled out (EMU_ENABLE_LOCK_STATS=0)." << std::endl;
+            return;
+        }
+
+        // Arithmetic with a PRINT every fourth statement, so the process log
+        // locks are exercised too. No SLEEP: the cycle clock may not be running.
+        ProgramBuilder builder;
+        builder.declare("x", 0);
+        for (int i = 1; i < length; i++) {
+            if (i % 4 == 0) builder.print("tick");
+            else builder.add("x", std::string("x"), uint16_t(1));
+        }
+        std::shared_ptr<const Program> program = builder.build();
+
+        // Round robin, so preemption and dispatch take the queue and core
+        // locks as well as the per-instruction path
+        Scheduler scheduler(cores);
+        scheduler.setSchedulerType("rr");
+        scheduler.setQuantumCycles(quantum);
+        scheduler.setDelay(0);
+        for (size_t i = 0; i < count; i++) {
+            scheduler.addProcess(new Process("bench" + std::to_string(i), program));
+        }
+        // Measure this run on a private baseline, so the counters 'lock-stat'
+        // reports are left as they were
+        bool was_active = lock_stats_active.exchange(true);
+        LockStatsBaseline before = snapshotLockStats();
+        auto begin = std::chrono::steady_clock::now();
+        scheduler.start();
+        while (scheduler.sampleMetrics().finished < count) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        double seconds = secondsSince(begin);
+        uint64_t instructions = scheduler.sampleMetrics().instructions;
+        scheduler.stop();
+        lock_stats_active = was_active;
+
+        std::cout << "Scheduler locks, RR quantum " << quantum << ", delay 0, " << cores << " cores, " << count
+            << " processes x " << program->source_lines << " instructions" << std::endl;
+        printRate("Throughput:", instructions, seconds);
+        printLockStats(before);
+    }
+
+    // benchmark tick [waiters] [ticks] [period-us]
+    void benchTick(const std::vector<std::string>& args) {
+        int count = static_cast<int>(argOr(args, 1, 4));
+        uint64_t ticks = argOr(args, 2, 200);
+        auto period = std::chrono::microseconds(argOr(args, 3, 1000));
+        if (count <= 0 || ticks == 0) {
+            std::cout << "Usage: benchmark tick [waiters] [ticks] [period-us], with at least one waiter and one tick"
+                << std::endl;
+            return;
+        }
+
+        std::cout << "Tick delivery, " << count << " waiters x " << ticks << " ticks, "
+            << period.count() << " us period" << std::endl;
+
+        for (bool polling : { true, false }) {
+            // A private counter, so the running emulator is not disturbed
+            std::atomic<uint64_t> counter{ 0 };
+            CycleWaiters waiters(counter);
+            std::vector<std::atomic<int64_t>> tick_ns(ticks + 1);
+            std::vector<std::vector<double>> latencies(count);
+            auto nowNs = []() {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+            };
+
+            double cpu_before = processCpuSeconds();
+            auto begin = std::chrono::steady_clock::now();
+            std::vector<std::thread> threads;
+            for (int t = 0; t < count; t++) {
+                threads.emplace_back([&, t]() {
+                    for (uint64_t k = 1; k <= ticks; k++) {
+                        while (counter < k) {
+                            if (polling) {
+                                // What worker() and batchWorker() used to do
+                                std::this_thread::sleep_for(std::chrono::microseconds(10));
+                            }
+                            else {
+                                waiters.waitFor(k);
+                            }
+                        }
+                        latencies[t].push_back((nowNs() - tick_ns[k]) / 1000.0);
+                    }
+                });
+            }
+            for (uint64_t k = 1; k <= ticks; k++) {
+                std::this_thread::sleep_until(begin + period * k);
+                tick_ns[k] = nowNs();
+                waiters.publish(++counter);
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            double wall = secondsSince(begin);
+            double cpu = processCpuSeconds() - cpu_before;
+
+            std::vector<double> all;
+            for (auto& l : latencies) {
+                all.insert(all.end(), l.begin(), l.end());
+            }
+            std::sort(all.begin(), all.end());
+            double sum = 0;
+            for (double v : all) sum += v;
+
+            std::cout << std::left << std::setw(18) << (polling ? "Sleep polling:" : "Atomic wait:") << std::right
+                << std::fixed << std::setprecision(1)
+                << "CPU " << std::setw(7) << cpu * 1000.0 << " ms (" << std::setw(5) << 100.0 * cpu / wall
+                << "% of a core)   wake latency avg " << std::setw(7) << sum / all.size()
+                << " us, p99 " << std::setw(7) << all[all.size() * 99 / 100]
+                << " us, max " << std::setw(8) << all.back() << " us" << std::endl;
+        }
+    }
+}
+
+void runBenchmark(const std::vector<std::string>& args) {
+    if (args.empty()) {
+        std::cout << "Usage: benchmark simd|loops [processes] [instructions]" << std::endl;
+        std::cout << "       benchmark worker [instructions] [processes]" << std::endl;
+        std::cout << "       benchmark tick [waiters] [ticks] [period-us]" << std::endl;
+        std::cout << "       benchmark locks [cores] [processes] [instructions] [quantum]" << std::endl;
+        return;
+    }
+
+    if (args[0] == "simd") {
+        benchSimd(args);
+    }
+    else if (args[0] == "loops") {
+        benchLoops(args);
+    }
+    else if (args[0] == "worker") {
+        benchWorker(args);
+    }
+    else if (args[0] == "tick") {
+        benchTick(args);
+    }
+    else if (args[0] == "locks") {
+        benchLocks(args);
+    }
+    else {
+        std::cout << "Unknown benchmark '" << args[0] << "'." << std::endl;
+    }
+}
@@ -0,0 +1,10 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <string>
+#include <vector>
+
+// Console benchmarks: "benchmark <name> [args...]"
+void runBenchmark(const std::vector<std::string>& args);
+
+#endif // BENCH_H
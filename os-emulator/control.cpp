@@ -0,0 +1,207 @@
+#include "control.h"
+#include "scheduler.h"
+#include "process.h"
+#include "ipc.h"
+#include <iostream>
+#include <sstream>
+#include <random>
+#include <cstdio>
+
+namespace {
+    // Upper bound on SPAWN so one request can't allocate without limit
+    constexpr uint64_t MAX_SPAWN = 100000;
+
+    const char* stateName(Process* p) {
+        switch (p->state.load()) {
+        case ProcessState::Running: return p->isSleeping() ? "sleeping" : "running";
+        case ProcessState::Finished: return "finished";
+        case ProcessState::Blocked: return "blocked";
+        default: return "waiting";
+        }
+    }
+
+    int randomLength(Scheduler& scheduler) {
+        thread_local std::mt19937 gen(std::random_device{}());
+        std::uniform_int_distribution<uint64_t> dist(
+            scheduler.getMinInstructions(), scheduler.getMaxInstructions());
+        return static_cast<int>(dist(gen));
+    }
+}
+
+bool ControlServer::start(Scheduler* scheduler_, const ControlConfig& config_) {
+    if (running || config_.socket.empty()) return false;
+    if (!ipcSupported()) {
+        std::cerr << "Control socket needs Unix domain sockets; not started." << std::endl;
+        return false;
+    }
+    listen_fd = ipcListen(config_.socket, config_.backlog);
+    if (listen_fd < 0) {
+        std::cerr << "Control socket: could not listen on " << config_.socket << std::endl;
+        return false;
+    }
+    scheduler = scheduler_;
+    config = config_;
+    stop_requested = false;
+    running = true;
+    accept_thread = std::thread(&ControlServer::acceptLoop, this);
+    return true;
+}
+
+void ControlServer::stop() {
+    if (!running) return;
+    stop_requested = true;
+    ipcShutdown(listen_fd);
+    if (accept_thread.joinable()) {
+        accept_thread.join();
+    }
+    ipcClose(listen_fd);
+    listen_fd = -1;
+    std::remove(config.socket.c_str());
+    reapClients(true);
+    running = false;
+}
+
+void ControlServer::acceptLoop() {
+    while (!stop_requested) {
+        int fd = ipcAccept(listen_fd);
+        if (fd < 0) {
+            if (stop_requested) break;
+            // e.g. out of descriptors: back off instead of spinning
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+        reapClients(false);
+        auto client = std::make_unique<Client>();
+        client->fd = fd;
+        Client* raw = client.get();
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        clients.push_back(std::move(client));
+        raw->thread = std::thread(&ControlServer::serve, this, raw);
+    }
+}
+
+// Joins finished clients, or every client when all is set. A client's fd is
+// closed only here, after its thread is gone, so shutdown never hits a
+// descriptor number that has been reused.
+void ControlServer::reapClients(bool all) {
+    std::lock_guard<std::mutex> lock(clients_mutex);
+    for (auto it = clients.begin(); it != clients.end();) {
+        Client& client = **it;
+        if (!all && !client.done) {
+            ++it;
+            continue;
+        }
+        ipcShutdown(client.fd);
+        if (client.thread.joinable()) {
+            client.thread.join();
+        }
+        ipcClose(client.fd);
+        it = clients.erase(it);
+    }
+}
+
+void ControlServer::serve(Client* client) {
+    std::string buffer, line, replies;
+    bool quit = false;
+    while (!quit && !stop_requested && ipcReceiveLine(client->fd, buffer, line)) {
+        if (!line.empty()) {
+            replies += handle(line, quit);
+        }
+        // Answer everything already pipelined with a single write
+        if (quit || buffer.find('\n') == std::string::npos) {
+            if (!replies.empty() && !ipcSendText(client->fd, replies)) break;
+            replies.clear();
+        }
+    }
+    // Hang up now, e.g. on a client dropped for an overlong line that is
+    // still writing; the fd itself is closed when the client is reaped
+    ipcShutdown(client->fd);
+    client->done = true;
+}
+
+std::string ControlServer::handle(const std::string& line, bool& quit) {
+    std::istringstream iss(line);
+    std::string verb, name;
+    iss >> verb;
+
+    if (verb == "CREATE") {
+        int created = 0, existing = 0, rejected = 0;
+        while (iss >> name) {
+            Process* p = new Process(name, randomLength(*scheduler));
+            AddResult result = scheduler->tryAddProcess(p);
+            if (result == AddResult::Added) {
+                created++;
+                continue;
+            }
+            delete p;
+            (result == AddResult::Exists ? existing : rejected)++;
+        }
+        return "OK " + std::to_string(created) + " " + std::to_string(existing)
+            + " " + std::to_string(rejected) + "\n";
+    }
+    else if (verb == "SPAWN") {
+        uint64_t count = 0;
+        std::string prefix = "ctl";
+        if (!(iss >> count) || count == 0 || count > MAX_SPAWN) {
+            return "ERR count must be 1.." + std::to_string(MAX_SPAWN) + "\n";
+        }
+        iss >> prefix;
+        std::string first, last;
+        uint64_t created = 0;
+        while (created < count) {
+            name = prefix + std::to_string(spawn_counter++);
+            Process* p = new Process(name, randomLength(*scheduler));
+            AddResult result = scheduler->tryAddProcess(p);
+            if (result != AddResult::Added) {
+                delete p;
+                // At an admission limit: report what was created so far
+                if (result == AddResult::Rejected) break;
+                // Name taken by another client or the console; draw the next one
+                continue;
+            }
+            if (first.empty()) first = name;
+            last = name;
+            created++;
+        }
+        if (created == 0) {
+            return "OK 0 - -\n";
+        }
+        return "OK " + std::to_string(created) + " " + first + " " + last + "\n";
+    }
+    else if (verb == "QUERY") {
+        std::string rows;
+        int count = 0;
+        while (iss >> name) {
+            count++;
+            bool found = scheduler->withProcess(name, [&](Process& p) {
+                int total = p.total_instructions;
+                int core = p.state == ProcessState::Running ? p.core_id.load() : -1;
+                rows += name + " " + std::to_string(p.pid) + " " + stateName(&p) + " "
+                    + std::to_string(total - p.remaining_instructions.load()) + "/" + std::to_string(total)
+                    + " " + std::to_string(core) + "\n";
+            });
+            if (found) continue;
+            ArchivedProcess record;
+            if (scheduler->getArchived(name, record)) {
+                std::string total = std::to_string(record.total_instructions);
+                rows += name + " " + std::to_string(record.pid) + " finished " + total + "/" + total + " -1\n";
+                continue;
+            }
+            rows += name + " missing\n";
+        }
+        return "OK " + std::to_string(count) + "\n" + rows;
+    }
+    else if (verb == "STATUS") {
+        MetricsSample sample = scheduler->sampleMetrics();
+        std::ostringstream out;
+        out << "OK cycle=" << sample.cycle << " cores=" << sample.num_cores
+            << " active=" << sample.active_cores << " running=" << sample.running
+            << " queued=" << sample.queue_depth << " finished=" << sample.finished << "\n";
+        return out.str();
+    }
+    else if (verb == "QUIT") {
+        quit = true;
+        return "OK\n";
+    }
+    return "ERR unknown request " + verb + "\n";
+}
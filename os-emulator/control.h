@@ -0,0 +1,63 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+class Scheduler;
+
+struct ControlConfig {
+    std::string socket;         // Unix socket path; empty disables the server
+    int backlog = 128;
+};
+
+// Command socket for scripted load: many clients at once, one thread each,
+// calling straight into the scheduler without any console rendering.
+// Requests and replies are single text lines; QUERY replies are followed by
+// one line per name. Clients may pipeline requests, and replies to every
+// complete line already received are sent back in one write.
+//
+//   CREATE <name>...           OK <created> <existing> <rejected>
+//   SPAWN <count> [prefix]     OK <created> <first> <last>, stopping early
+//                              (and "- -" if none) at an admission limit
+//   QUERY <name>...            OK <n>, then "<name> <pid> <state> <done>/<total> <core>"
+//                              or "<name> missing" per name
+//   STATUS                     OK cycle=.. cores=.. active=.. running=.. queued=.. finished=..
+//   QUIT                       closes the connection
+class ControlServer {
+public:
+    ~ControlServer() { stop(); }
+
+    bool start(Scheduler* scheduler, const ControlConfig& config);
+    void stop();
+    bool isRunning() const { return running; }
+
+private:
+    struct Client {
+        int fd = -1;
+        std::thread thread;
+        std::atomic<bool> done{ false };
+    };
+
+    Scheduler* scheduler = nullptr;
+    ControlConfig config;
+    int listen_fd = -1;
+    std::thread accept_thread;
+    std::atomic<bool> running{ false };
+    std::atomic<bool> stop_requested{ false };
+    std::mutex clients_mutex;
+    std::list<std::unique_ptr<Client>> clients;
+    std::atomic<uint64_t> spawn_counter{ 1 };
+
+    void acceptLoop();
+    void serve(Client* client);
+    std::string handle(const std::string& line, bool& quit);
+    void reapClients(bool all);
+};
+
+#endif // CONTROL_H
@@ -0,0 +1,148 @@
+#include "core_pool.h"
+#include <chrono>
+
+namespace {
+    constexpr int STEPS_PER_SLICE = 64;     // instructions run before a core is re-queued
+    constexpr int STALLED_STEPS = 64;       // unproductive steps before backing off
+}
+
+CorePool::~CorePool() {
+    stop();
+}
+
+void CorePool::start(int num_cores, int num_threads, std::function<CoreStep(int)> step_fn,
+    std::function<bool(int)> has_work_fn, std::function<void(int)> on_thread_start_fn)
+{
+    step = std::move(step_fn);
+    has_work = std::move(has_work_fn);
+    on_thread_start = std::move(on_thread_start_fn);
+    stop_requested = false;
+    queued = std::make_unique<std::atomic<bool>[]>(num_cores);
+    for (int i = 0; i < num_cores; i++) {
+        queued[i] = false;
+    }
+    if (num_threads < 1) num_threads = 1;
+    for (int i = 0; i < num_threads; i++) {
+        queues.push_back(std::make_unique<LocalQueue>());
+    }
+    for (int i = 0; i < num_threads; i++) {
+        threads.push_back(std::thread(&CorePool::run, this, i));
+    }
+}
+
+void CorePool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(injected_mutex);
+        stop_requested = true;
+    }
+    work_available.notify_all();
+    for (auto& t : threads) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+    threads.clear();
+    queues.clear();
+    injected.clear();
+}
+
+void CorePool::wake(int core_id) {
+    if (queued[core_id].exchange(true)) return;
+    {
+        std::lock_guard<std::mutex> lock(injected_mutex);
+        injected.push_back(core_id);
+    }
+    work_available.notify_one();
+}
+
+void CorePool::run(int thread_id) {
+    if (on_thread_start) {
+        on_thread_start(thread_id);
+    }
+    int stalled = 0;
+    while (!stop_requested) {
+        int core_id;
+        if (!popLocal(thread_id, core_id) && !popInjected(core_id) && !steal(thread_id, core_id)) {
+            std::unique_lock<std::mutex> lock(injected_mutex);
+            work_available.wait_for(lock, std::chrono::milliseconds(1),
+                [this] { return stop_requested || !injected.empty(); });
+            continue;
+        }
+
+        CoreStep result = CoreStep::Executed;
+        for (int i = 0; i < STEPS_PER_SLICE && result == CoreStep::Executed && !stop_requested; i++) {
+            result = step(core_id);
+        }
+
+        if (result == CoreStep::Idle) {
+            // Park the core. A process may have been assigned after the step
+            // looked, in which case wake() saw the flag still set and skipped it.
+            queued[core_id] = false;
+            if (has_work(core_id) && !queued[core_id].exchange(true)) {
+                pushLocal(thread_id, core_id);
+            }
+            continue;
+        }
+
+        requeue(thread_id, core_id);
+        if (result == CoreStep::Executed) {
+            stalled = 0;
+        }
+        else if (++stalled >= STALLED_STEPS) {
+            // Every core we hold is waiting on the cycle clock
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            stalled = 0;
+        }
+    }
+}
+
+bool CorePool::popLocal(int thread_id, int& core_id) {
+    LocalQueue& q = *queues[thread_id];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.cores.empty()) return false;
+    core_id = q.cores.front();
+    q.cores.pop_front();
+    return true;
+}
+
+bool CorePool::popInjected(int& core_id) {
+    std::lock_guard<std::mutex> lock(injected_mutex);
+    if (injected.empty()) return false;
+    core_id = injected.front();
+    injected.pop_front();
+    return true;
+}
+
+bool CorePool::steal(int thread_id, int& core_id) {
+    int n = static_cast<int>(queues.size());
+    for (int i = 1; i < n; i++) {
+        LocalQueue& q = *queues[(thread_id + i) % n];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (!q.cores.empty()) {
+            core_id = q.cores.back();
+            q.cores.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+// A core that used up its slice goes behind every core still waiting for a
+// thread, so M threads take turns over N > M cores instead of each one
+// sticking to the core it happened to pop first
+void CorePool::requeue(int thread_id, int core_id) {
+    {
+        std::lock_guard<std::mutex> lock(injected_mutex);
+        if (!injected.empty()) {
+            injected.push_back(core_id);
+            return;
+        }
+    }
+    pushLocal(thread_id, core_id);
+}
+
+void CorePool::pushLocal(int thread_id, int core_id) {
+    LocalQueue& q = *queues[thread_id];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    q.cores.push_back(core_id);
+}
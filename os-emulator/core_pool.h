@@ -0,0 +1,56 @@
+#ifndef CORE_POOL_H
+#define CORE_POOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <functional>
+
+// Result of running one emulated core for one step.
+enum class CoreStep { Executed, Busy, Sleeping, Idle };
+
+// Work-stealing pool that multiplexes many emulated cores onto a fixed set
+// of host threads (M:N mode). A core is queued only while it has a process
+// assigned; once a step reports Idle it is parked until wake() is called.
+class CorePool {
+public:
+    CorePool() = default;
+    ~CorePool();
+
+    // on_thread_start runs first on each pool thread, e.g. to pin it
+    void start(int num_cores, int num_threads, std::function<CoreStep(int)> step,
+        std::function<bool(int)> has_work, std::function<void(int)> on_thread_start = {});
+    void stop();
+    void wake(int core_id);
+    int getThreadCount() const { return static_cast<int>(threads.size()); }
+
+private:
+    struct LocalQueue {
+        std::mutex mutex;
+        std::deque<int> cores;
+    };
+
+    std::function<CoreStep(int)> step;
+    std::function<bool(int)> has_work;
+    std::function<void(int)> on_thread_start;
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<LocalQueue>> queues;
+    std::unique_ptr<std::atomic<bool>[]> queued;
+    std::deque<int> injected;
+    std::mutex injected_mutex;
+    std::condition_variable work_available;
+    std::atomic<bool> stop_requested{ false };
+
+    void run(int thread_id);
+    bool popLocal(int thread_id, int& core_id);
+    bool popInjected(int& core_id);
+    bool steal(int thread_id, int& core_id);
+    void pushLocal(int thread_id, int core_id);
+    void requeue(int thread_id, int core_id);
+};
+
+#endif // CORE_POOL_H
@@ -0,0 +1,229 @@
+#include "cycle_clock.h"
+#include "affinity.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <bit>
+
+#ifdef __linux__
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+CycleWaiters cycle_waiters(cpu_cycles);
+
+bool CycleWaiters::waitFor(uint64_t target, const std::atomic<bool>* stop) {
+    if (counter >= target) return true;
+
+    std::atomic<int> flag{ PENDING };
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        waiters.push({ target, &flag });
+        earliest = waiters.top().target;
+    }
+    // A tick may have landed between the first check and registering; the
+    // clock could have missed us, so publish on its behalf
+    uint64_t now = counter;
+    if (now >= target) {
+        publish(now);
+    }
+    // Likewise a stop that was signalled before we registered
+    else if (stop && *stop) {
+        wakeAll();
+    }
+
+    flag.wait(PENDING);
+    // The waker may still be inside notify_one; keep the flag alive until
+    // it marks the flag released
+    int result;
+    while (!((result = flag.load()) & RELEASED)) {
+        std::this_thread::yield();
+    }
+    return result == (REACHED | RELEASED);
+}
+
+void CycleWaiters::wake(std::atomic<int>* flag, int result) {
+    flag->store(result);
+    flag->notify_one();
+    flag->store(result | RELEASED);
+}
+
+void CycleWaiters::publish(uint64_t now) {
+    if (earliest.load() > now) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    while (!waiters.empty() && waiters.top().target <= now) {
+        std::atomic<int>* flag = waiters.top().flag;
+        waiters.pop();
+        wake(flag, REACHED);
+    }
+    earliest = waiters.empty() ? UINT64_MAX : waiters.top().target;
+}
+
+void CycleWaiters::wakeAll() {
+    std::lock_guard<std::mutex> lock(mutex);
+    while (!waiters.empty()) {
+        std::atomic<int>* flag = waiters.top().flag;
+        waiters.pop();
+        wake(flag, CANCELLED);
+    }
+    earliest = UINT64_MAX;
+}
+
+void CycleClock::start(std::chrono::microseconds tick_period, int clock_cpu) {
+    if (running) return;
+    cpu = clock_cpu;
+    period = std::max<std::chrono::nanoseconds>(tick_period, std::chrono::microseconds(1));
+    delivered = 0;
+    wakeups = 0;
+    missed = 0;
+    late_sum_ns = 0;
+    late_max_ns = 0;
+    for (auto& bucket : late_buckets) {
+        bucket = 0;
+    }
+    stop_requested = false;
+    running = true;
+    pinned = false;
+    thread = std::thread(&CycleClock::run, this);
+    pinned.wait(false);
+}
+
+void CycleClock::stop() {
+    if (!running) return;
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        stop_requested = true;
+    }
+    wake.notify_all();
+#ifdef __linux__
+    // Re-arm to expire now so the blocked read returns
+    if (timer_fd >= 0) {
+        itimerspec now{};
+        now.it_value.tv_nsec = 1;
+        timerfd_settime(timer_fd, 0, &now, nullptr);
+    }
+#endif
+    if (thread.joinable()) {
+        thread.join();
+    }
+#ifdef __linux__
+    if (timer_fd >= 0) {
+        close(timer_fd);
+        timer_fd = -1;
+    }
+#endif
+    running = false;
+}
+
+void CycleClock::run() {
+    pinCurrentThread("clock", cpu >= 0 ? std::vector<int>{ cpu } : std::vector<int>{});
+
+    // The timer is armed before start returns, so stop can always re-arm it
+#ifdef __linux__
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, 0);
+    if (timer_fd >= 0) {
+        itimerspec spec{};
+        spec.it_interval.tv_sec = period.count() / 1000000000;
+        spec.it_interval.tv_nsec = period.count() % 1000000000;
+        spec.it_value = spec.it_interval;
+        begin = std::chrono::steady_clock::now();
+        timerfd_settime(timer_fd, 0, &spec, nullptr);
+    }
+#endif
+    if (timer_fd < 0) {
+        begin = std::chrono::steady_clock::now();
+    }
+    pinned = true;
+    pinned.notify_one();
+
+#ifdef __linux__
+    if (timer_fd >= 0) {
+        while (true) {
+            // Blocks until at least one expiration; more than one means we
+            // were late and those ticks are delivered now
+            uint64_t expirations = 0;
+            bool expired = read(timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations);
+            if (stop_requested) break;
+            if (expired) {
+                deliver(delivered + expirations);
+            }
+        }
+        return;
+    }
+#endif
+    std::unique_lock<std::mutex> lock(wake_mutex);
+    while (!wake.wait_until(lock, begin + period * (delivered + 1), [this] { return stop_requested.load(); })) {
+        uint64_t due = (std::chrono::steady_clock::now() - begin) / period;
+        if (due > delivered) {
+            deliver(due);
+        }
+    }
+}
+
+void CycleClock::deliver(uint64_t due) {
+    uint64_t count = due - delivered;
+    for (uint64_t i = 0; i < count; i++) {
+        advanceCycle();
+    }
+    delivered = due;
+
+    auto deadline = begin + period * delivered;
+    auto now = std::chrono::steady_clock::now();
+    uint64_t late = now > deadline
+        ? std::chrono::duration_cast<std::chrono::nanoseconds>(now - deadline).count() : 0;
+    int bucket = std::min<int>(static_cast<int>(std::bit_width(late)), LATE_BUCKETS - 1);
+
+    wakeups.store(wakeups.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    missed.store(missed.load(std::memory_order_relaxed) + count - 1, std::memory_order_relaxed);
+    late_sum_ns.store(late_sum_ns.load(std::memory_order_relaxed) + late, std::memory_order_relaxed);
+    if (late > late_max_ns.load(std::memory_order_relaxed)) {
+        late_max_ns.store(late, std::memory_order_relaxed);
+    }
+    late_buckets[bucket].store(late_buckets[bucket].load(std::memory_order_relaxed) + 1,
+        std::memory_order_relaxed);
+}
+
+ClockStats CycleClock::getStats() const {
+    ClockStats stats;
+    stats.period_ns = period.count();
+    stats.wakeups = wakeups.load(std::memory_order_relaxed);
+    stats.missed = missed.load(std::memory_order_relaxed);
+    stats.ticks = stats.wakeups + stats.missed;
+    if (stats.wakeups == 0) return stats;
+
+    stats.avg_late_us = late_sum_ns.load(std::memory_order_relaxed) / 1000.0 / stats.wakeups;
+    stats.max_late_us = late_max_ns.load(std::memory_order_relaxed) / 1000.0;
+    // Upper bound of the bucket holding the 99th percentile
+    uint64_t target = stats.wakeups * 99 / 100;
+    uint64_t seen = 0;
+    for (int b = 0; b < LATE_BUCKETS; b++) {
+        seen += late_buckets[b].load(std::memory_order_relaxed);
+        if (seen > target) {
+            stats.p99_late_us = std::min(static_cast<double>(uint64_t(1) << b) / 1000.0, stats.max_late_us);
+            break;
+        }
+    }
+    return stats;
+}
+
+void CycleClock::printStats() const {
+    ClockStats stats = getStats();
+    std::ios_base::fmtflags flags = std::cout.flags();
+    std::streamsize precision = std::cout.precision();
+    std::cout << "--------------------------------------" << std::endl;
+    std::cout << "Cycle clock: " << (running ? "running" : "stopped") << ", period "
+        << stats.period_ns / 1000 << " us"
+#ifdef __linux__
+        << " (timerfd)"
+#endif
+        << std::endl;
+    std::cout << "Ticks: " << stats.ticks << "     Wake-ups: " << stats.wakeups
+        << "     Missed (caught up): " << stats.missed << std::endl;
+    std::cout << std::fixed << std::setprecision(1)
+        << "Wake-up lateness: avg " << stats.avg_late_us << " us, p99 <= " << stats.p99_late_us
+        << " us, max " << stats.max_late_us << " us" << std::endl;
+    std::cout << "--------------------------------------" << std::endl;
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+}
@@ -0,0 +1,108 @@
+#ifndef CYCLE_CLOCK_H
+#define CYCLE_CLOCK_H
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <vector>
+#include <cstdint>
+
+extern std::atomic<uint64_t> cpu_cycles;
+
+// Threads waiting for a cycle counter to reach a target cycle. Each waiter
+// sleeps on its own atomic flag (a futex on Linux, WaitOnAddress on Windows)
+// and the clock wakes only the waiters whose cycle has arrived, so nothing
+// polls and nobody is woken early.
+class CycleWaiters {
+public:
+    explicit CycleWaiters(std::atomic<uint64_t>& counter) : counter(counter) {}
+
+    // Blocks until the counter reaches target. Returns false if released
+    // early by wakeAll() or if stop is set; callers re-check and loop.
+    bool waitFor(uint64_t target, const std::atomic<bool>* stop = nullptr);
+
+    // Called by the clock after every increment
+    void publish(uint64_t now);
+
+    // Releases every current waiter, e.g. when a component is stopping
+    void wakeAll();
+
+private:
+    static void wake(std::atomic<int>* flag, int result);
+
+    enum : int { PENDING = 0, REACHED = 1, CANCELLED = 2, RELEASED = 4 };
+
+    struct Waiter {
+        uint64_t target;
+        std::atomic<int>* flag;
+        bool operator>(const Waiter& other) const { return target > other.target; }
+    };
+
+    std::atomic<uint64_t>& counter;
+    std::mutex mutex;
+    std::priority_queue<Waiter, std::vector<Waiter>, std::greater<Waiter>> waiters;
+    std::atomic<uint64_t> earliest{ UINT64_MAX };
+};
+
+extern CycleWaiters cycle_waiters;
+
+// Advances cpu_cycles by one tick and wakes the waiters it satisfies
+inline void advanceCycle() {
+    cycle_waiters.publish(++cpu_cycles);
+}
+
+struct ClockStats {
+    uint64_t period_ns = 0;
+    uint64_t ticks = 0;         // cycles advanced
+    uint64_t wakeups = 0;
+    uint64_t missed = 0;        // ticks that arrived late and were caught up in a batch
+    double avg_late_us = 0;     // wake-up time past the tick's deadline
+    double p99_late_us = 0;
+    double max_late_us = 0;
+};
+
+// Drives cpu_cycles at a fixed period. Ticks are scheduled against absolute
+// deadlines (a timerfd on Linux), so a late wake-up delivers every tick that
+// came due instead of dropping them or drifting.
+class CycleClock {
+public:
+    ~CycleClock() { stop(); }
+
+    // cpu >= 0 pins the clock thread there; start returns once it has
+    void start(std::chrono::microseconds period, int cpu = -1);
+    void stop();
+    bool isRunning() const { return running; }
+    ClockStats getStats() const;
+    void printStats() const;
+
+private:
+    static constexpr int LATE_BUCKETS = 40;     // log2(ns)
+
+    std::thread thread;
+    std::atomic<bool> running{ false };
+    std::atomic<bool> stop_requested{ false };
+    std::atomic<bool> pinned{ false };
+    int cpu = -1;
+    std::chrono::nanoseconds period{ 0 };
+    std::chrono::steady_clock::time_point begin;
+    uint64_t delivered = 0;
+    // stop() uses these to wake the thread without waiting out the period
+    int timer_fd = -1;          // Linux; closed by stop() after the join
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+
+    // Written by the clock thread only
+    std::atomic<uint64_t> wakeups{ 0 };
+    std::atomic<uint64_t> missed{ 0 };
+    std::atomic<uint64_t> late_sum_ns{ 0 };
+    std::atomic<uint64_t> late_max_ns{ 0 };
+    std::atomic<uint64_t> late_buckets[LATE_BUCKETS] = {};
+
+    void run();
+    void deliver(uint64_t due);
+};
+
+#endif // CYCLE_CLOCK_H
@@ -0,0 +1,142 @@
+#include "generator.h"
+#include <chrono>
+
+ArrivalModel::ArrivalModel(const ArrivalConfig& config)
+    : config(config), poisson(config.rate > 0 ? config.rate : 1.0) {}
+
+uint64_t ArrivalModel::arrivals(uint64_t period, std::mt19937& gen) {
+    if (config.model == "poisson") {
+        return poisson(gen);
+    }
+    if (config.model == "bursty") {
+        uint64_t cycle_len = config.burst_on + config.burst_off;
+        if (cycle_len == 0 || period % cycle_len < config.burst_on) {
+            return config.per_tick;
+        }
+        return 0;
+    }
+    return config.per_tick;
+}
+
+ProcessGenerator::~ProcessGenerator() {
+    stop();
+}
+
+void ProcessGenerator::start(const ArrivalConfig& cfg, uint64_t min_ins, uint64_t max_ins,
+    std::atomic<int>* counter)
+{
+    config = cfg;
+    if (config.buffer_size == 0) config.buffer_size = 1;
+    min_instructions = min_ins;
+    max_instructions = max_ins;
+    process_counter = counter;
+    stop_requested = false;
+
+    std::random_device rd;
+    for (int i = 0; i < config.generator_threads; i++) {
+        threads.push_back(std::thread(&ProcessGenerator::generatorThread, this, rd()));
+    }
+}
+
+void ProcessGenerator::stop() {
+    {
+        std::lock_guard<std::mutex> lock(ready_mutex);
+        stop_requested = true;
+    }
+    not_empty.notify_all();
+    not_full.notify_all();
+    for (auto& t : threads) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+    threads.clear();
+
+    // Pre-built processes that never arrived were not handed to the scheduler
+    std::lock_guard<std::mutex> lock(ready_mutex);
+    for (Process* p : ready) {
+        delete p;
+    }
+    ready.clear();
+}
+
+Process* ProcessGenerator::build(std::mt19937& gen) {
+    std::uniform_int_distribution<uint64_t> dist(min_instructions, max_instructions);
+    auto begin = std::chrono::steady_clock::now();
+
+    std::string name = "p" + std::to_string((*process_counter)++);
+    Process* p = new Process(name, dist(gen));
+
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    generation_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    generated++;
+    return p;
+}
+
+void ProcessGenerator::generatorThread(unsigned seed) {
+    std::mt19937 gen(seed);
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(ready_mutex);
+            not_full.wait(lock, [this] {
+                return stop_requested || ready.size() < config.buffer_size;
+                });
+            if (stop_requested) return;
+        }
+
+        Process* p = build(gen);
+
+        std::unique_lock<std::mutex> lock(ready_mutex);
+        if (stop_requested) {
+            delete p;
+            return;
+        }
+        ready.push_back(p);
+        lock.unlock();
+        not_empty.notify_one();
+    }
+}
+
+Process* ProcessGenerator::take() {
+    taken++;
+    if (threads.empty()) {
+        static thread_local std::mt19937 gen(std::random_device{}());
+        return build(gen);
+    }
+
+    std::unique_lock<std::mutex> lock(ready_mutex);
+    if (ready.empty()) {
+        auto begin = std::chrono::steady_clock::now();
+        stalls++;
+        not_empty.wait(lock, [this] { return stop_requested || !ready.empty(); });
+        auto elapsed = std::chrono::steady_clock::now() - begin;
+        stall_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    }
+    if (ready.empty()) return nullptr;
+
+    Process* p = ready.front();
+    ready.pop_front();
+    lock.unlock();
+    not_full.notify_one();
+    return p;
+}
+
+void ProcessGenerator::recordDispatch(uint64_t ns) {
+    dispatched++;
+    dispatch_ns += ns;
+}
+
+GeneratorStats ProcessGenerator::getStats() {
+    GeneratorStats stats;
+    stats.generated = generated;
+    stats.generation_ns = generation_ns;
+    stats.taken = taken;
+    stats.stalls = stalls;
+    stats.stall_ns = stall_ns;
+    stats.dispatched = dispatched;
+    stats.dispatch_ns = dispatch_ns;
+    stats.skipped_periods = skipped_periods;
+    std::lock_guard<std::mutex> lock(ready_mutex);
+    stats.buffered = ready.size();
+    return stats;
+}
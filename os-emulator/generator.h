@@ -0,0 +1,90 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include "process.h"
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <random>
+#include <cstdint>
+
+struct ArrivalConfig {
+    std::string model = "fixed";    // "fixed", "poisson" or "bursty"
+    uint64_t per_tick = 1;          // arrivals per batch period (fixed, bursty on-phase)
+    double rate = 1.0;              // mean arrivals per batch period (poisson)
+    uint64_t burst_on = 5;          // periods with arrivals (bursty)
+    uint64_t burst_off = 5;         // periods without arrivals (bursty)
+    int generator_threads = 0;      // 0 builds processes inline on the batch thread
+    size_t buffer_size = 64;        // pre-built processes kept ready
+};
+
+// Decides how many processes arrive in a given batch period.
+class ArrivalModel {
+public:
+    explicit ArrivalModel(const ArrivalConfig& config);
+    uint64_t arrivals(uint64_t period, std::mt19937& gen);
+
+private:
+    ArrivalConfig config;
+    std::poisson_distribution<uint64_t> poisson;
+};
+
+struct GeneratorStats {
+    uint64_t generated = 0;
+    uint64_t generation_ns = 0;     // time spent building programs
+    uint64_t taken = 0;
+    uint64_t stalls = 0;            // takes that found the ready buffer empty
+    uint64_t stall_ns = 0;
+    uint64_t dispatched = 0;
+    uint64_t dispatch_ns = 0;       // time spent in Scheduler::addProcess
+    uint64_t skipped_periods = 0;   // batch periods dropped after the batch worker fell behind
+    size_t buffered = 0;
+};
+
+// Builds Process objects ahead of their arrival. With generator_threads > 0
+// a small pool keeps up to buffer_size processes ready so that the batch
+// thread only pops a finished object when an arrival is due.
+class ProcessGenerator {
+public:
+    ProcessGenerator() = default;
+    ~ProcessGenerator();
+
+    void start(const ArrivalConfig& config, uint64_t min_ins, uint64_t max_ins,
+        std::atomic<int>* counter);
+    void stop();
+    Process* take();
+    void recordDispatch(uint64_t ns);
+    void recordSkipped(uint64_t periods) { skipped_periods += periods; }
+    GeneratorStats getStats();
+
+private:
+    ArrivalConfig config;
+    uint64_t min_instructions = 1;
+    uint64_t max_instructions = 1;
+    std::atomic<int>* process_counter = nullptr;
+
+    std::vector<std::thread> threads;
+    std::deque<Process*> ready;
+    std::mutex ready_mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::atomic<bool> stop_requested{ false };
+
+    std::atomic<uint64_t> generated{ 0 };
+    std::atomic<uint64_t> generation_ns{ 0 };
+    std::atomic<uint64_t> taken{ 0 };
+    std::atomic<uint64_t> stalls{ 0 };
+    std::atomic<uint64_t> stall_ns{ 0 };
+    std::atomic<uint64_t> dispatched{ 0 };
+    std::atomic<uint64_t> dispatch_ns{ 0 };
+    std::atomic<uint64_t> skipped_periods{ 0 };
+
+    Process* build(std::mt19937& gen);
+    void generatorThread(unsigned seed);
+};
+
+#endif // GENERATOR_H
@@ -0,0 +1,390 @@
+#include "image.h"
+#include "mapped_file.h"
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <mutex>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <climits>
+#include <cctype>
+
+namespace {
+    std::string trim(const std::string& text) {
+        size_t begin = text.find_first_not_of(" \t\r");
+        if (begin == std::string::npos) return "";
+        size_t end = text.find_last_not_of(" \t\r");
+        return text.substr(begin, end - begin + 1);
+    }
+
+    // Position of c outside double-quoted text, or npos
+    size_t findUnquoted(const std::string& text, char c, size_t from = 0) {
+        bool quoted = false;
+        for (size_t i = from; i < text.size(); i++) {
+            if (text[i] == '"') quoted = !quoted;
+            else if (text[i] == c && !quoted) return i;
+        }
+        return std::string::npos;
+    }
+
+    std::vector<std::string> splitArguments(const std::string& text) {
+        std::vector<std::string> args;
+        size_t start = 0;
+        while (true) {
+            size_t comma = findUnquoted(text, ',', start);
+            args.push_back(trim(text.substr(start, comma == std::string::npos ? std::string::npos : comma - start)));
+            if (comma == std::string::npos) break;
+            start = comma + 1;
+        }
+        if (args.size() == 1 && args[0].empty()) args.clear();
+        return args;
+    }
+
+    bool parseNumber(const std::string& token, uint64_t& value) {
+        if (token.empty() || token.size() > 19) return false;
+        for (char c : token) {
+            if (!std::isdigit(static_cast<unsigned char>(c))) return false;
+        }
+        value = std::stoull(token);
+        return true;
+    }
+
+    bool isIdentifier(const std::string& token) {
+        if (token.empty() || !(std::isalpha(static_cast<unsigned char>(token[0])) || token[0] == '_')) return false;
+        return std::all_of(token.begin(), token.end(), [](char c) {
+            return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+            });
+    }
+
+    bool parseValue(const std::string& token, Value& value) {
+        uint64_t number;
+        if (parseNumber(token, number)) {
+            value = static_cast<uint16_t>(std::min<uint64_t>(number, UINT16_MAX));
+            return true;
+        }
+        if (isIdentifier(token)) {
+            value = token;
+            return true;
+        }
+        return false;
+    }
+
+    // Parses one statement into the builder; returns an error message or ""
+    std::string assembleLine(const std::string& line, ProgramBuilder& builder) {
+        if (line == "}") {
+            return builder.endLoop() ? "" : "'}' without a matching FOR";
+        }
+        size_t open = line.find('(');
+        size_t close = open == std::string::npos ? std::string::npos : findUnquoted(line, ')', open);
+        if (close == std::string::npos) return "expected INSTRUCTION(arguments)";
+
+        std::string verb = trim(line.substr(0, open));
+        std::transform(verb.begin(), verb.end(), verb.begin(),
+            [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+        std::vector<std::string> args = splitArguments(line.substr(open + 1, close - open - 1));
+        std::string rest = trim(line.substr(close + 1));
+        if (verb != "FOR" && !rest.empty()) return "unexpected '" + rest + "'";
+
+        Value lhs, rhs;
+        uint64_t number;
+        if (verb == "PRINT") {
+            if (args.size() != 1 || args[0].size() < 2 || args[0].front() != '"' || args[0].back() != '"') {
+                return "PRINT takes one quoted string";
+            }
+            builder.print(args[0].substr(1, args[0].size() - 2));
+        }
+        else if (verb == "DECLARE") {
+            if (args.size() != 2 || !isIdentifier(args[0]) || !parseNumber(args[1], number)) {
+                return "DECLARE takes a variable and a number";
+            }
+            builder.declare(args[0], static_cast<uint16_t>(std::min<uint64_t>(number, UINT16_MAX)));
+        }
+        else if (verb == "ADD" || verb == "SUBTRACT") {
+            if (args.size() != 3 || !isIdentifier(args[0])
+                || !parseValue(args[1], lhs) || !parseValue(args[2], rhs)) {
+                return verb + " takes a variable and two operands";
+            }
+            if (verb == "ADD") builder.add(args[0], lhs, rhs);
+            else builder.subtract(args[0], lhs, rhs);
+        }
+        else if (verb == "SLEEP") {
+            if (args.size() != 1 || !parseNumber(args[0], number) || number > UINT8_MAX) {
+                return "SLEEP takes a tick count from 0 to 255";
+            }
+            builder.sleep(static_cast<uint8_t>(number));
+        }
+        else if (verb == "READ" || verb == "WRITE") {
+            uint64_t kb;
+            if (args.size() != 2 || !parseNumber(args[0], number) || number > UINT8_MAX
+                || !parseNumber(args[1], kb) || kb == 0 || kb > UINT16_MAX) {
+                return verb + " takes a device number and a size in KB";
+            }
+            builder.io(verb == "WRITE", static_cast<uint8_t>(number), static_cast<uint16_t>(kb));
+        }
+        else if (verb == "FOR") {
+            if (args.size() != 1 || !parseNumber(args[0], number) || number > UINT16_MAX) {
+                return "FOR takes a repeat count from 0 to 65535";
+            }
+            if (rest != "{") return "FOR(n) must be followed by '{'";
+            if (!builder.beginLoop(static_cast<uint16_t>(number))) {
+                return "FOR nested deeper than " + std::to_string(MAX_LOOP_DEPTH);
+            }
+        }
+        else {
+            return "unknown instruction " + verb;
+        }
+        return "";
+    }
+
+    // Everything the interpreter trusts about code: operands in range and
+    // loops properly nested with consistent offsets. Also totals the
+    // source lines the code accounts for.
+    std::string validateCode(const Op* code, size_t count, size_t constants, size_t variables,
+        uint64_t& lines)
+    {
+        std::vector<size_t> begins;
+        for (size_t i = 0; i < count; i++) {
+            const Op& op = code[i];
+            int slots = 0;
+            switch (op.code) {
+            case OpCode::Nop:
+            case OpCode::Sleep:
+            case OpCode::Read:
+            case OpCode::Write:
+                break;
+            case OpCode::Print:
+                if (op.arg >= constants) return "PRINT constant out of range";
+                break;
+            case OpCode::Declare:
+            case OpCode::ForDeclare:
+                slots = 1;
+                break;
+            case OpCode::Add:
+            case OpCode::Subtract:
+            case OpCode::SubtractIV:
+            case OpCode::ForAdd:
+            case OpCode::ForSubtract:
+                slots = 2;
+                break;
+            case OpCode::AddVV:
+            case OpCode::SubtractVV:
+            case OpCode::DeclareAdd:
+                slots = 3;
+                break;
+            case OpCode::LoopBegin:
+                if (begins.size() >= MAX_LOOP_DEPTH) return "loops nested too deeply";
+                if (op.arg == 0 || i + op.arg >= count || code[i + op.arg].code != OpCode::LoopEnd) {
+                    return "loop without a matching end";
+                }
+                begins.push_back(i);
+                break;
+            case OpCode::LoopEnd:
+                if (begins.empty() || i - begins.back() != code[begins.back()].arg
+                    || op.arg != i - begins.back() - 1) {
+                    return "loop end without a matching begin";
+                }
+                begins.pop_back();
+                break;
+            default:
+                return "unknown opcode " + std::to_string(static_cast<int>(op.code));
+            }
+            if ((slots >= 1 && op.a >= variables) || (slots >= 2 && op.b >= variables)
+                || (slots >= 3 && op.c >= variables)) {
+                return "variable slot out of range";
+            }
+        }
+        if (!begins.empty()) return "unterminated loop";
+
+        lines = 0;
+        for (size_t pc = 0; pc < count; pc += code[pc].code == OpCode::LoopBegin ? code[pc].arg + 1 : 1) {
+            lines += statementLines(code, pc);
+        }
+        return "";
+    }
+
+    bool readStrings(const MappedFile& file, uint64_t offset, uint64_t count,
+        std::vector<std::string>& out)
+    {
+        for (uint64_t i = 0; i < count; i++) {
+            uint32_t length;
+            if (offset > file.size() || file.size() - offset < sizeof(length)) return false;
+            std::memcpy(&length, file.data() + offset, sizeof(length));
+            offset += sizeof(length);
+            if (file.size() - offset < length) return false;
+            out.emplace_back(file.data() + offset, length);
+            offset += length;
+        }
+        return true;
+    }
+
+    void writeStrings(std::ostream& out, const std::vector<std::string>& strings) {
+        for (const std::string& s : strings) {
+            uint32_t length = static_cast<uint32_t>(s.size());
+            out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+            out.write(s.data(), s.size());
+        }
+    }
+
+    uint64_t stringsSize(const std::vector<std::string>& strings) {
+        uint64_t size = 0;
+        for (const std::string& s : strings) {
+            size += sizeof(uint32_t) + s.size();
+        }
+        return size;
+    }
+
+    struct CachedImage {
+        std::weak_ptr<const Program> program;
+        std::filesystem::file_time_type modified;
+        uintmax_t size = 0;
+    };
+
+    std::mutex cache_mutex;
+    std::map<std::string, CachedImage> image_cache;
+}
+
+std::shared_ptr<Program> assembleProgram(const std::string& source_path, std::string& error) {
+    std::ifstream in(source_path);
+    if (!in) {
+        error = "cannot open " + source_path;
+        return nullptr;
+    }
+
+    ProgramBuilder builder;
+    std::string line;
+    int number = 0;
+    while (std::getline(in, line)) {
+        number++;
+        size_t comment = findUnquoted(line, '#');
+        line = trim(comment == std::string::npos ? line : line.substr(0, comment));
+        if (line.empty()) continue;
+        std::string message = assembleLine(line, builder);
+        if (!message.empty()) {
+            error = "line " + std::to_string(number) + ": " + message;
+            return nullptr;
+        }
+    }
+    if (builder.depth() > 0) {
+        error = "line " + std::to_string(number) + ": missing '}'";
+        return nullptr;
+    }
+    auto program = builder.build();
+    if (program->code.empty()) {
+        error = "no instructions";
+        return nullptr;
+    }
+    if (program->source_lines > INT_MAX) {
+        error = "program too long";
+        return nullptr;
+    }
+    return program;
+}
+
+bool writeProgramImage(const Program& program, const std::string& path, std::string& error) {
+    ImageHeader header{};
+    std::memcpy(header.magic, IMAGE_MAGIC, sizeof(header.magic));
+    header.version = IMAGE_VERSION;
+    header.op_size = sizeof(Op);
+    header.source_lines = program.source_lines;
+    header.code_offset = (sizeof(ImageHeader) + 7) / 8 * 8;
+    header.code_count = program.opCount();
+    header.constants_offset = header.code_offset + header.code_count * sizeof(Op);
+    header.constants_count = program.constants.size();
+    header.names_offset = header.constants_offset + stringsSize(program.constants);
+    header.names_count = program.var_names.size();
+
+    // Written beside the target and renamed over it, so processes still
+    // running a previous version keep their mapping of the old file
+    std::string temporary = path + ".tmp";
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        error = "cannot write " + path;
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (size_t pad = sizeof(header); pad < header.code_offset; pad++) {
+        out.put('\0');
+    }
+    out.write(reinterpret_cast<const char*>(program.ops()), header.code_count * sizeof(Op));
+    writeStrings(out, program.constants);
+    writeStrings(out, program.var_names);
+    out.close();
+    std::error_code fs_error;
+    if (!out || (std::filesystem::rename(temporary, path, fs_error), fs_error)) {
+        std::filesystem::remove(temporary, fs_error);
+        error = "write to " + path + " failed";
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<const Program> loadProgramImage(const std::string& path, std::string& error) {
+    std::error_code fs_error;
+    std::string key = std::filesystem::weakly_canonical(path, fs_error).string();
+    if (fs_error) key = path;
+    auto modified = std::filesystem::last_write_time(path, fs_error);
+    uintmax_t size = fs_error ? 0 : std::filesystem::file_size(path, fs_error);
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto cached = image_cache.find(key);
+    if (cached != image_cache.end() && cached->second.modified == modified && cached->second.size == size) {
+        if (auto program = cached->second.program.lock()) {
+            return program;
+        }
+    }
+
+    // Only read while loading: the code is copied out before it is validated,
+    // so the file changing under a running process cannot affect it
+    MappedFile file;
+    if (!file.open(path)) {
+        error = "cannot open " + path;
+        return nullptr;
+    }
+    ImageHeader header;
+    if (file.size() < sizeof(header)) {
+        error = "not a program image";
+        return nullptr;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, IMAGE_MAGIC, sizeof(header.magic)) != 0) {
+        error = "not a program image";
+        return nullptr;
+    }
+    if (header.version != IMAGE_VERSION || header.op_size != sizeof(Op)) {
+        error = "unsupported image version " + std::to_string(header.version);
+        return nullptr;
+    }
+    if (header.code_offset % alignof(uint64_t) != 0 || header.code_offset > file.size()
+        || header.code_count == 0 || header.code_count > (file.size() - header.code_offset) / sizeof(Op)
+        || header.names_count > 256 || header.constants_count > UINT16_MAX + 1ULL) {
+        error = "corrupt image header";
+        return nullptr;
+    }
+
+    auto program = std::make_shared<Program>();
+    if (!readStrings(file, header.constants_offset, header.constants_count, program->constants)
+        || !readStrings(file, header.names_offset, header.names_count, program->var_names)) {
+        error = "corrupt string table";
+        return nullptr;
+    }
+    program->code.resize(header.code_count);
+    std::memcpy(program->code.data(), file.data() + header.code_offset, header.code_count * sizeof(Op));
+    file.close();
+
+    uint64_t lines = 0;
+    error = validateCode(program->code.data(), program->code.size(),
+        program->constants.size(), program->var_names.size(), lines);
+    if (!error.empty()) {
+        return nullptr;
+    }
+    if (lines != header.source_lines || lines == 0 || lines > INT_MAX) {
+        error = "source line count does not match the code";
+        return nullptr;
+    }
+    program->source_lines = lines;
+    program->image_path = key;
+
+    image_cache[key] = { program, modified, size };
+    return program;
+}
@@ -0,0 +1,53 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "program.h"
+#include <string>
+#include <memory>
+#include <cstdint>
+
+// Binary program image. Sections follow the header at the offsets it gives:
+//
+//   code         code_count Ops, stored exactly as the interpreter reads them
+//   constants    constants_count strings (uint32 length + bytes), PRINT text
+//   names        names_count strings, variable slot -> name
+//
+// Code is stored 8-byte aligned. Loading copies it into one validated heap
+// Program per image file, shared by every process that runs the image; each
+// process keeps only its own position and variables. Executing in place from
+// the file mapping (zero-copy) was dropped for safety: another writer could
+// change or truncate the file after validation.
+constexpr char IMAGE_MAGIC[8] = { 'C', 'S', 'I', 'M', 'A', 'G', 'E', '1' };
+constexpr uint32_t IMAGE_VERSION = 1;
+
+struct ImageHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t op_size;
+    uint64_t source_lines;
+    uint64_t code_offset;
+    uint64_t code_count;
+    uint64_t constants_offset;
+    uint64_t constants_count;
+    uint64_t names_offset;
+    uint64_t names_count;
+};
+
+// Compiles program text, one statement per line:
+//
+//   DECLARE(x, 5)    ADD(x, x, 1)    SUBTRACT(y, 100, x)
+//   PRINT("text")    SLEEP(3)        FOR(3) {  ...  }
+//   READ(device, kb)                 WRITE(device, kb)
+//
+// Operands are variable names or numbers (clamped to 0..65535). '#' starts a
+// comment. On failure error holds "line N: reason".
+std::shared_ptr<Program> assembleProgram(const std::string& source_path, std::string& error);
+
+bool writeProgramImage(const Program& program, const std::string& path, std::string& error);
+
+// Reads and validates an image into a Program that owns its code. Loads of
+// the same unchanged file return the same Program while any process still
+// uses it.
+std::shared_ptr<const Program> loadProgramImage(const std::string& path, std::string& error);
+
+#endif // IMAGE_H
@@ -0,0 +1,78 @@
+#include "io.h"
+#include "process.h"
+#include <algorithm>
+
+void IoSubsystem::configure(const IoConfig& config) {
+    std::lock_guard<std::mutex> lock(mutex);
+    devices.clear();
+    for (const IoDeviceConfig& device : config.devices) {
+        devices.push_back({});
+        devices.back().stats.config = device;
+        devices.back().stats.config.kb_per_cycle = std::max<uint64_t>(device.kb_per_cycle, 1);
+    }
+    if (devices.empty()) {
+        devices.push_back({});
+    }
+}
+
+void IoSubsystem::submit(Process* p, const std::vector<IoRequest>& requests) {
+    if (requests.empty()) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t now = cpu_cycles;
+    for (const IoRequest& request : requests) {
+        size_t index = request.device % devices.size();
+        Device& device = devices[index];
+        const IoDeviceConfig& config = device.stats.config;
+
+        uint64_t transfer = (request.kb + config.kb_per_cycle - 1) / config.kb_per_cycle;
+        uint64_t start = std::max(now, device.free_at);
+        device.free_at = start + transfer;
+        uint64_t complete_at = start + transfer + config.latency_cycles;
+
+        (request.write ? device.stats.writes : device.stats.reads)++;
+        device.stats.kb += request.kb;
+        device.stats.in_flight++;
+        device.stats.max_in_flight = std::max(device.stats.max_in_flight, device.stats.in_flight);
+        in_flight.push({ complete_at, now, p, index });
+    }
+    outstanding[p] += static_cast<int>(requests.size());
+    earliest = in_flight.top().complete_at;
+}
+
+void IoSubsystem::collectCompletions(uint64_t now, std::vector<Process*>& ready) {
+    if (earliest.load(std::memory_order_relaxed) > now) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    while (!in_flight.empty() && in_flight.top().complete_at <= now) {
+        InFlight done = in_flight.top();
+        in_flight.pop();
+
+        IoDeviceStats& stats = devices[done.device].stats;
+        uint64_t latency = now - done.submitted_at;
+        stats.in_flight--;
+        stats.completed++;
+        stats.latency_sum += latency;
+        stats.latency_max = std::max(stats.latency_max, latency);
+
+        auto it = outstanding.find(done.process);
+        if (--it->second == 0) {
+            outstanding.erase(it);
+            ready.push_back(done.process);
+        }
+    }
+    earliest = in_flight.empty() ? UINT64_MAX : in_flight.top().complete_at;
+}
+
+size_t IoSubsystem::getBlockedCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return outstanding.size();
+}
+
+std::vector<IoDeviceStats> IoSubsystem::getStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<IoDeviceStats> stats;
+    for (const Device& device : devices) {
+        stats.push_back(device.stats);
+    }
+    return stats;
+}
@@ -0,0 +1,83 @@
+#ifndef IO_H
+#define IO_H
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+class Process;
+
+// An emulated device: requests pay a fixed latency plus transfer time.
+// Transfers on one device are serialised; latencies overlap, so a device
+// with several requests in flight behaves like a pipelined disk.
+struct IoDeviceConfig {
+    std::string name = "disk0";
+    uint64_t latency_cycles = 10;
+    uint64_t kb_per_cycle = 64;
+};
+
+struct IoConfig {
+    std::vector<IoDeviceConfig> devices;    // empty: a single default device
+};
+
+// Issued by READ/WRITE; the device index wraps around the configured devices
+struct IoRequest {
+    uint8_t device;
+    bool write;
+    uint16_t kb;
+};
+
+struct IoDeviceStats {
+    IoDeviceConfig config;
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    uint64_t kb = 0;
+    uint64_t completed = 0;
+    uint64_t in_flight = 0;         // current queue depth
+    uint64_t max_in_flight = 0;
+    uint64_t latency_sum = 0;       // cycles from submission to completion
+    uint64_t latency_max = 0;
+};
+
+// Device models plus a completion queue. A core submits a blocked process's
+// requests and moves on to other work; the scheduler collects processes
+// whose requests have all completed and puts them back in the ready queue.
+class IoSubsystem {
+public:
+    IoSubsystem() { configure({}); }
+    void configure(const IoConfig& config);
+
+    void submit(Process* p, const std::vector<IoRequest>& requests);
+    // Appends processes whose last outstanding request completed by now
+    void collectCompletions(uint64_t now, std::vector<Process*>& ready);
+
+    size_t getBlockedCount();
+    std::vector<IoDeviceStats> getStats();
+
+private:
+    struct Device {
+        IoDeviceStats stats;
+        uint64_t free_at = 0;       // cycle the transfer channel frees up
+    };
+
+    struct InFlight {
+        uint64_t complete_at;
+        uint64_t submitted_at;
+        Process* process;
+        size_t device;
+        bool operator>(const InFlight& other) const { return complete_at > other.complete_at; }
+    };
+
+    std::mutex mutex;
+    std::vector<Device> devices;
+    std::priority_queue<InFlight, std::vector<InFlight>, std::greater<InFlight>> in_flight;
+    std::unordered_map<Process*, int> outstanding;
+    // Lets collectCompletions skip the lock while nothing is due
+    std::atomic<uint64_t> earliest{ UINT64_MAX };
+};
+
+#endif // IO_H
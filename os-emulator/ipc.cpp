@@ -0,0 +1,136 @@
+#include "ipc.h"
+
+#ifdef _WIN32
+
+bool ipcSupported() { return false; }
+int ipcListen(const std::string&, int) { return -1; }
+int ipcAccept(int) { return -1; }
+int ipcConnect(const std::string&) { return -1; }
+bool ipcSend(int, const std::string&) { return false; }
+bool ipcReceive(int, std::string&) { return false; }
+void ipcClose(int) {}
+void ipcShutdown(int) {}
+bool ipcSendText(int, const std::string&) { return false; }
+bool ipcReceiveLine(int, std::string&, std::string&) { return false; }
+
+#else
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+
+namespace {
+    bool fillAddress(const std::string& path, sockaddr_un& address) {
+        if (path.size() >= sizeof(address.sun_path)) return false;
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+
+    bool writeAll(int fd, const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            data += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    bool readAll(int fd, char* data, size_t size) {
+        while (size > 0) {
+            ssize_t n = ::recv(fd, data, size, 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            data += n;
+            size -= n;
+        }
+        return true;
+    }
+}
+
+bool ipcSupported() { return true; }
+
+int ipcListen(const std::string& path, int backlog) {
+    sockaddr_un address;
+    if (!fillAddress(path, address)) return -1;
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    ::unlink(path.c_str());
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+        || ::listen(fd, backlog) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int ipcAccept(int listen_fd) {
+    int fd;
+    do {
+        fd = ::accept(listen_fd, nullptr, nullptr);
+    } while (fd < 0 && errno == EINTR);
+    return fd;
+}
+
+int ipcConnect(const std::string& path) {
+    sockaddr_un address;
+    if (!fillAddress(path, address)) return -1;
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool ipcSend(int fd, const std::string& message) {
+    uint32_t size = static_cast<uint32_t>(message.size());
+    return writeAll(fd, reinterpret_cast<const char*>(&size), sizeof(size))
+        && writeAll(fd, message.data(), message.size());
+}
+
+bool ipcReceive(int fd, std::string& message) {
+    uint32_t size = 0;
+    if (!readAll(fd, reinterpret_cast<char*>(&size), sizeof(size))) return false;
+    message.resize(size);
+    return size == 0 || readAll(fd, message.data(), size);
+}
+
+void ipcClose(int fd) {
+    if (fd >= 0) ::close(fd);
+}
+
+void ipcShutdown(int fd) {
+    if (fd >= 0) ::shutdown(fd, SHUT_RDWR);
+}
+
+bool ipcSendText(int fd, const std::string& text) {
+    return writeAll(fd, text.data(), text.size());
+}
+
+bool ipcReceiveLine(int fd, std::string& buffer, std::string& line) {
+    size_t newline;
+    size_t scanned = 0;
+    while ((newline = buffer.find('\n', scanned)) == std::string::npos) {
+        // Everything buffered is one unfinished line
+        if (buffer.size() > IPC_MAX_LINE) return false;
+        scanned = buffer.size();
+        char chunk[4096];
+        ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        buffer.append(chunk, n);
+    }
+    if (newline > IPC_MAX_LINE) return false;
+    line.assign(buffer, 0, newline);
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    buffer.erase(0, newline + 1);
+    return true;
+}
+
+#endif
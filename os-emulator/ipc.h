@@ -0,0 +1,120 @@
+#ifndef IPC_H
+#define IPC_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Local IPC over Unix domain sockets. Messages are framed as a 32-bit
+// length followed by the bytes. Only available on POSIX systems; on Windows
+// every call fails.
+bool ipcSupported();
+int ipcListen(const std::string& path, int backlog = 8);
+int ipcAccept(int listen_fd);
+int ipcConnect(const std::string& path);
+bool ipcSend(int fd, const std::string& message);
+bool ipcReceive(int fd, std::string& message);
+void ipcClose(int fd);
+// Wakes any thread blocked in accept or receive on fd
+void ipcShutdown(int fd);
+
+// Unframed text, for line-oriented clients such as scripts and socat.
+// buffer carries bytes read past the end of the line to the next call.
+// Receiving fails on disconnect and on a line longer than IPC_MAX_LINE,
+// so a client that never sends a newline cannot grow buffer without bound.
+constexpr size_t IPC_MAX_LINE = 64 * 1024;
+bool ipcSendText(int fd, const std::string& text);
+bool ipcReceiveLine(int fd, std::string& buffer, std::string& line);
+
+// Flat binary encoding for messages exchanged between instances of this
+// program on the same host (same endianness and layout)
+class ByteWriter {
+public:
+    template <class T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        bytes.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    void putString(const std::string& value) {
+        put<uint32_t>(static_cast<uint32_t>(value.size()));
+        bytes += value;
+    }
+    template <class T>
+    void putVector(const std::vector<T>& values) {
+        putArray(values.data(), values.size());
+    }
+    // Same encoding as putVector, read back with getVector
+    template <class T>
+    void putArray(const T* values, size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        put<uint32_t>(static_cast<uint32_t>(count));
+        bytes.append(reinterpret_cast<const char*>(values), count * sizeof(T));
+    }
+    void putStrings(const std::vector<std::string>& values) {
+        put<uint32_t>(static_cast<uint32_t>(values.size()));
+        for (const auto& value : values) {
+            putString(value);
+        }
+    }
+    const std::string& data() const { return bytes; }
+
+private:
+    std::string bytes;
+};
+
+// Reads what ByteWriter wrote. Reading past the end sets a failure flag
+// and yields zeroes instead of throwing.
+class ByteReader {
+public:
+    explicit ByteReader(const std::string& bytes) : bytes(bytes) {}
+
+    template <class T>
+    T get() {
+        T value{};
+        if (!take(&value, sizeof(T))) return T{};
+        return value;
+    }
+    std::string getString() {
+        uint32_t size = get<uint32_t>();
+        if (failed || size > bytes.size() - offset) { failed = true; return {}; }
+        std::string value = bytes.substr(offset, size);
+        offset += size;
+        return value;
+    }
+    template <class T>
+    std::vector<T> getVector() {
+        uint32_t size = get<uint32_t>();
+        if (failed || size > (bytes.size() - offset) / sizeof(T)) { failed = true; return {}; }
+        std::vector<T> values(size);
+        take(values.data(), size * sizeof(T));
+        return values;
+    }
+    std::vector<std::string> getStrings() {
+        uint32_t size = get<uint32_t>();
+        std::vector<std::string> values;
+        for (uint32_t i = 0; i < size && !failed; i++) {
+            values.push_back(getString());
+        }
+        return values;
+    }
+    bool ok() const { return !failed; }
+
+private:
+    const std::string& bytes;
+    size_t offset = 0;
+    bool failed = false;
+
+    bool take(void* out, size_t size) {
+        if (failed || size > bytes.size() - offset) {
+            failed = true;
+            return false;
+        }
+        std::memcpy(out, bytes.data() + offset, size);
+        offset += size;
+        return true;
+    }
+};
+
+#endif // IPC_H
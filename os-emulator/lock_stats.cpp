@@ -0,0 +1,176 @@
+#include "lock_stats.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <memory>
+#include <bit>
+#include <algorithm>
+
+std::atomic<bool> lock_stats_active{ false };
+
+namespace {
+    // A reset moves the baseline instead of clearing the counters, so it
+    // never races with threads holding the locks
+    struct Entry {
+        std::string name;
+        LockCounters counters;
+        LockSnapshot baseline;
+    };
+
+    std::mutex registry_mutex;
+    std::vector<std::unique_ptr<Entry>>& registry() {
+        static auto* entries = new std::vector<std::unique_ptr<Entry>>();
+        return *entries;
+    }
+
+    int bucketFor(uint64_t ns) {
+        return std::min<int>(static_cast<int>(std::bit_width(ns)), LOCK_BUCKETS - 1);
+    }
+
+    LockSnapshot snapshot(const LockCounters& c) {
+        LockSnapshot s;
+        s.acquisitions = c.acquisitions.load(std::memory_order_relaxed);
+        s.contended = c.contended.load(std::memory_order_relaxed);
+        s.wait_ns = c.wait_ns.load(std::memory_order_relaxed);
+        s.hold_ns = c.hold_ns.load(std::memory_order_relaxed);
+        for (int b = 0; b < LOCK_BUCKETS; b++) {
+            s.wait_buckets[b] = c.wait_buckets[b].load(std::memory_order_relaxed);
+            s.hold_buckets[b] = c.hold_buckets[b].load(std::memory_order_relaxed);
+        }
+        return s;
+    }
+
+    // Upper bound of the bucket holding the p-th sample, in microseconds
+    double percentileUs(const uint64_t (&buckets)[LOCK_BUCKETS], uint64_t count, double p) {
+        if (count == 0) return 0.0;
+        uint64_t target = static_cast<uint64_t>(p * count);
+        uint64_t seen = 0;
+        for (int b = 0; b < LOCK_BUCKETS; b++) {
+            seen += buckets[b];
+            if (seen > target) {
+                return static_cast<double>(uint64_t(1) << b) / 1000.0;
+            }
+        }
+        return static_cast<double>(uint64_t(1) << (LOCK_BUCKETS - 1)) / 1000.0;
+    }
+}
+
+void LockCounters::recordWait(uint64_t ns) {
+    wait_ns.fetch_add(ns, std::memory_order_relaxed);
+    wait_buckets[bucketFor(ns)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void LockCounters::recordHold(uint64_t ns) {
+    hold_ns.fetch_add(ns, std::memory_order_relaxed);
+    hold_buckets[bucketFor(ns)].fetch_add(1, std::memory_order_relaxed);
+}
+
+LockCounters& lockCounters(const char* name) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (auto& entry : registry()) {
+        if (entry->name == name) return entry->counters;
+    }
+    registry().push_back(std::make_unique<Entry>());
+    registry().back()->name = name;
+    return registry().back()->counters;
+}
+
+void resetLockStats() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (auto& entry : registry()) {
+        entry->baseline = snapshot(entry->counters);
+    }
+}
+
+LockStatsBaseline snapshotLockStats() {
+    LockStatsBaseline snapshots;
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (auto& entry : registry()) {
+        snapshots[entry->name] = snapshot(entry->counters);
+    }
+    return snapshots;
+}
+
+namespace {
+    // Prints one row per lock, counting from the snapshot baselineFor returns
+    template <typename Baseline>
+    void printRows(Baseline baselineFor) {
+        std::ios_base::fmtflags flags = std::cout.flags();
+        std::streamsize precision = std::cout.precision();
+
+        std::cout << "--------------------------------------" << std::endl;
+        std::cout << std::left << std::setw(16) << "Lock" << std::right
+            << std::setw(12) << "Acquired" << std::setw(11) << "Contended" << std::setw(8) << "Cont%"
+            << std::setw(11) << "Wait ms" << std::setw(10) << "Wait p99"
+            << std::setw(10) << "Hold avg" << std::setw(10) << "Hold p50" << std::setw(10) << "Hold p99"
+            << std::endl;
+        std::cout << std::fixed;
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            for (auto& entry : registry()) {
+                LockSnapshot now = snapshot(entry->counters);
+                const LockSnapshot& base = baselineFor(*entry, now);
+                LockSnapshot d;
+                d.acquisitions = now.acquisitions - base.acquisitions;
+                d.contended = now.contended - base.contended;
+                d.wait_ns = now.wait_ns - base.wait_ns;
+                d.hold_ns = now.hold_ns - base.hold_ns;
+                uint64_t holds = 0;
+                for (int b = 0; b < LOCK_BUCKETS; b++) {
+                    d.wait_buckets[b] = now.wait_buckets[b] - base.wait_buckets[b];
+                    d.hold_buckets[b] = now.hold_buckets[b] - base.hold_buckets[b];
+                    holds += d.hold_buckets[b];
+                }
+
+                std::cout << std::left << std::setw(16) << entry->name << std::right
+                    << std::setw(12) << d.acquisitions << std::setw(11) << d.contended
+                    << std::setw(8) << std::setprecision(2)
+                    << (d.acquisitions ? 100.0 * d.contended / d.acquisitions : 0.0)
+                    << std::setw(11) << std::setprecision(1) << d.wait_ns / 1e6
+                    << std::setw(10) << std::setprecision(2) << percentileUs(d.wait_buckets, d.contended, 0.99)
+                    << std::setw(10) << (holds ? d.hold_ns / 1000.0 / holds : 0.0)
+                    << std::setw(10) << percentileUs(d.hold_buckets, holds, 0.50)
+                    << std::setw(10) << percentileUs(d.hold_buckets, holds, 0.99) << std::endl;
+            }
+        }
+        std::cout.flags(flags);
+        std::cout.precision(precision);
+        std::cout << "(times in us unless noted; waits are over contended acquisitions only)" << std::endl;
+        std::cout << "--------------------------------------" << std::endl;
+    }
+
+    bool reportCompiledOut() {
+        if (lock_stats_enabled) return false;
+        std::cout << "Lock statistics were compiled out (EMU_ENABLE_LOCK_STATS=0)." << std::endl;
+        return true;
+    }
+}
+
+void printLockStats(bool reset) {
+    if (reportCompiledOut()) return;
+    // The baseline moves while printing; a copy keeps the row's delta intact
+    LockSnapshot previous;
+    printRows([&](Entry& entry, const LockSnapshot& now) -> const LockSnapshot& {
+        previous = entry.baseline;
+        if (reset) {
+            entry.baseline = now;
+        }
+        return previous;
+    });
+    if (reset) {
+        std::cout << "Lock counters reset." << std::endl;
+    }
+    if (!lock_stats_active) {
+        std::cout << "Lock statistics are off; run 'lock-stat-start' to collect them." << std::endl;
+    }
+}
+
+void printLockStats(const LockStatsBaseline& since) {
+    if (reportCompiledOut()) return;
+    static const LockSnapshot zero;
+    printRows([&](Entry& entry, const LockSnapshot&) -> const LockSnapshot& {
+        auto it = since.find(entry.name);
+        return it != since.end() ? it->second : zero;
+    });
+}
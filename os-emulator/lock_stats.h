@@ -0,0 +1,133 @@
+#ifndef LOCK_STATS_H
+#define LOCK_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <cstdint>
+#include <string>
+#include <map>
+
+// Build with EMU_ENABLE_LOCK_STATS=0 to make InstrumentedMutex a plain std::mutex
+#ifndef EMU_ENABLE_LOCK_STATS
+#define EMU_ENABLE_LOCK_STATS 1
+#endif
+
+constexpr bool lock_stats_enabled = EMU_ENABLE_LOCK_STATS != 0;
+
+// Runtime switch, off by default: while off, an InstrumentedMutex costs one
+// relaxed load per lock and takes no timestamps
+extern std::atomic<bool> lock_stats_active;
+
+constexpr int LOCK_BUCKETS = 32;        // log2(ns) histogram buckets
+
+// Counters for one lock name. Every mutex created with the same name adds
+// to the same entry, so e.g. all Process log mutexes report together.
+struct LockCounters {
+    std::atomic<uint64_t> acquisitions{ 0 };
+    std::atomic<uint64_t> contended{ 0 };   // try_lock failed, the caller had to wait
+    std::atomic<uint64_t> wait_ns{ 0 };
+    std::atomic<uint64_t> hold_ns{ 0 };
+    std::atomic<uint64_t> wait_buckets[LOCK_BUCKETS] = {};
+    std::atomic<uint64_t> hold_buckets[LOCK_BUCKETS] = {};
+
+    void recordWait(uint64_t ns);
+    void recordHold(uint64_t ns);
+};
+
+// Counter values of one lock at a point in time
+struct LockSnapshot {
+    uint64_t acquisitions = 0;
+    uint64_t contended = 0;
+    uint64_t wait_ns = 0;
+    uint64_t hold_ns = 0;
+    uint64_t wait_buckets[LOCK_BUCKETS] = {};
+    uint64_t hold_buckets[LOCK_BUCKETS] = {};
+};
+
+using LockStatsBaseline = std::map<std::string, LockSnapshot>;
+
+// Returns the entry for name, creating it on first use; entries live for
+// the rest of the program
+LockCounters& lockCounters(const char* name);
+
+// Prints acquisitions, contention and wait/hold percentiles per lock since
+// the previous reset
+void printLockStats(bool reset = true);
+void resetLockStats();
+
+// For callers measuring their own interval without moving the shared
+// baseline: take a snapshot, then print the change since it
+LockStatsBaseline snapshotLockStats();
+void printLockStats(const LockStatsBaseline& since);
+
+template <bool Enabled>
+class BasicInstrumentedMutex : public std::mutex {
+public:
+    explicit BasicInstrumentedMutex(const char*) {}
+    explicit BasicInstrumentedMutex(LockCounters&) {}
+};
+
+template <>
+class BasicInstrumentedMutex<true> {
+public:
+    explicit BasicInstrumentedMutex(const char* name) : counters(lockCounters(name)) {}
+    // For mutexes created often: look the counters up once and pass them in
+    explicit BasicInstrumentedMutex(LockCounters& counters) : counters(counters) {}
+    BasicInstrumentedMutex(const BasicInstrumentedMutex&) = delete;
+    BasicInstrumentedMutex& operator=(const BasicInstrumentedMutex&) = delete;
+
+    void lock() {
+        if (!lock_stats_active.load(std::memory_order_relaxed)) {
+            mutex.lock();
+            timed = false;
+            return;
+        }
+        timed = true;
+        // Only a failed try_lock pays for timing the wait
+        if (mutex.try_lock()) {
+            counters.acquisitions.fetch_add(1, std::memory_order_relaxed);
+        }
+        else {
+            auto begin = std::chrono::steady_clock::now();
+            mutex.lock();
+            acquired = std::chrono::steady_clock::now();
+            counters.acquisitions.fetch_add(1, std::memory_order_relaxed);
+            counters.contended.fetch_add(1, std::memory_order_relaxed);
+            counters.recordWait(std::chrono::duration_cast<std::chrono::nanoseconds>(acquired - begin).count());
+            return;
+        }
+        acquired = std::chrono::steady_clock::now();
+    }
+
+    bool try_lock() {
+        if (!mutex.try_lock()) return false;
+        timed = lock_stats_active.load(std::memory_order_relaxed);
+        if (!timed) return true;
+        counters.acquisitions.fetch_add(1, std::memory_order_relaxed);
+        acquired = std::chrono::steady_clock::now();
+        return true;
+    }
+
+    void unlock() {
+        // acquired and timed are only touched by the holder, so read them
+        // before releasing
+        if (!timed) {
+            mutex.unlock();
+            return;
+        }
+        auto held = std::chrono::steady_clock::now() - acquired;
+        mutex.unlock();
+        counters.recordHold(std::chrono::duration_cast<std::chrono::nanoseconds>(held).count());
+    }
+
+private:
+    std::mutex mutex;
+    LockCounters& counters;
+    std::chrono::steady_clock::time_point acquired;
+    bool timed = false;         // this hold is being measured
+};
+
+using InstrumentedMutex = BasicInstrumentedMutex<lock_stats_enabled>;
+
+#endif // LOCK_STATS_H
@@ -1,6 +1,14 @@
 #include "scheduler.h"
 #include "process.h"
 #include "header.h"
+#include "bench.h"
+#include "trace.h"
+#include "profiler.h"
+#include "lock_stats.h"
+#include "cycle_clock.h"
+#include "shard.h"
+#include "ipc.h"
+#include "image.h"
 #include <iostream>
 #include <string>
 #include <sstream>
@@ -20,9 +28,11 @@
 #endif
 
 Scheduler* scheduler = nullptr;
+ShardCluster* cluster = nullptr;
 bool initialized = false;
 std::atomic<uint64_t> cpu_cycles(0);
 std::atomic<uint64_t> quantum_counter(0);
+CycleClock cycle_clock;
 
 struct Config {
     int num_cpu = 4;
@@ -32,6 +42,20 @@ struct Config {
     uint64_t min_instructions = 1;
     uint64_t max_instructions = 2000;
     uint64_t delay_per_exec = 100;
+    uint64_t tick_period_us = 100000;
+    std::string execution_mode = "threads";
+    int pool_threads = 0;
+    int shards = 0;
+    std::string workload_file;
+    MetricsConfig metrics;
+    ArrivalConfig arrivals;
+    StatsConfig stats;
+    ControlConfig control;
+    AdmissionConfig admission;
+    IoConfig io;
+    ArchiveConfig archive;
+    QuantumConfig quantum;
+    AffinityConfig affinity;
 };
 
 Config readConfig(const std::string& filename, const std::filesystem::path& exe_dir) {
@@ -89,10 +113,236 @@ Config readConfig(const std::string& filename, const std::filesystem::path& exe_
         else if (key == "delay-per-exec") {
             iss >> config.delay_per_exec;
         }
+        else if (key == "tick-period-us") {
+            iss >> config.tick_period_us;
+        }
+        else if (key == "execution-mode") {
+            iss >> config.execution_mode;
+        }
+        else if (key == "pool-threads") {
+            iss >> config.pool_threads;
+        }
+        else if (key == "shards") {
+            iss >> config.shards;
+        }
+        else if (key == "arrival-model") {
+            iss >> config.arrivals.model;
+        }
+        else if (key == "arrivals-per-tick") {
+            iss >> config.arrivals.per_tick;
+        }
+        else if (key == "arrival-rate") {
+            iss >> config.arrivals.rate;
+        }
+        else if (key == "burst-on") {
+            iss >> config.arrivals.burst_on;
+        }
+        else if (key == "burst-off") {
+            iss >> config.arrivals.burst_off;
+        }
+        else if (key == "generator-threads") {
+            iss >> config.arrivals.generator_threads;
+        }
+        else if (key == "generator-buffer") {
+            iss >> config.arrivals.buffer_size;
+        }
+        else if (key == "stats-interval-ms") {
+            iss >> config.stats.interval_ms;
+        }
+        else if (key == "stats-segment") {
+            iss >> config.stats.segment;
+        }
+        else if (key == "max-queue-depth") {
+            iss >> config.admission.max_queue_depth;
+        }
+        else if (key == "max-resident-bytes") {
+            iss >> config.admission.max_resident_bytes;
+        }
+        else if (key == "admission-policy") {
+            iss >> config.admission.policy;
+        }
+        else if (key == "quantum-mode") {
+            iss >> config.quantum.mode;
+        }
+        else if (key == "quantum-min") {
+            iss >> config.quantum.min_quantum;
+        }
+        else if (key == "quantum-max") {
+            iss >> config.quantum.max_quantum;
+        }
+        else if (key == "quantum-target-wait-ms") {
+            iss >> config.quantum.target_wait_ms;
+        }
+        else if (key == "quantum-max-overhead") {
+            // Percent of core time
+            double percent;
+            if (iss >> percent) config.quantum.max_overhead = percent / 100.0;
+        }
+        else if (key == "quantum-interval-ms") {
+            iss >> config.quantum.interval_ms;
+        }
+        else if (key == "quantum-log") {
+            iss >> config.quantum.log_file;
+        }
+        else if (key == "worker-cpus") {
+            // worker-cpus <list>, e.g. 0-3,8: core i is pinned to the i-th CPU, wrapping
+            std::string list;
+            iss >> list;
+            if (!parseCpuList(list, config.affinity.worker_cpus)) {
+                std::cerr << "Error: Invalid CPU list for worker-cpus: " << list << std::endl;
+            }
+        }
+        else if (key == "core-cpus") {
+            // core-cpus <core> <list>, once per core that gets its own set
+            int core = -1;
+            std::string list;
+            std::vector<int> cpus;
+            if (iss >> core >> list && core >= 0 && parseCpuList(list, cpus)) {
+                config.affinity.core_cpus[core] = cpus;
+            }
+            else {
+                std::cerr << "Error: Invalid core-cpus entry: " << line << std::endl;
+            }
+        }
+        else if (key == "clock-cpu") {
+            iss >> config.affinity.clock_cpu;
+            if (config.affinity.clock_cpu >= hostCpuCount()) {
+                std::cerr << "Error: Invalid CPU for clock-cpu: " << config.affinity.clock_cpu << std::endl;
+                config.affinity.clock_cpu = -1;
+            }
+        }
+        else if (key == "dispatcher-cpu") {
+            iss >> config.affinity.dispatcher_cpu;
+            if (config.affinity.dispatcher_cpu >= hostCpuCount()) {
+                std::cerr << "Error: Invalid CPU for dispatcher-cpu: " << config.affinity.dispatcher_cpu << std::endl;
+                config.affinity.dispatcher_cpu = -1;
+            }
+        }
+        else if (key == "isolate-cpus") {
+            iss >> config.affinity.isolate;
+        }
+        else if (key == "numa-local") {
+            iss >> config.affinity.numa_local;
+        }
+        else if (key == "archive-file") {
+            iss >> config.archive.file;
+        }
+        else if (key == "archive-after-ms") {
+            iss >> config.archive.after_ms;
+        }
+        else if (key == "archive-block-kb") {
+            iss >> config.archive.block_kb;
+        }
+        else if (key == "io-device") {
+            // io-device <name> <latency-cycles> <kb-per-cycle>, once per device
+            IoDeviceConfig device;
+            iss >> device.name >> device.latency_cycles >> device.kb_per_cycle;
+            config.io.devices.push_back(device);
+        }
+        else if (key == "workload-file") {
+            iss >> config.workload_file;
+        }
+        else if (key == "control-socket") {
+            iss >> config.control.socket;
+        }
+        else if (key == "control-backlog") {
+            iss >> config.control.backlog;
+        }
+        else if (key == "metrics-interval") {
+            iss >> config.metrics.interval_cycles;
+        }
+        else if (key == "metrics-file") {
+            iss >> config.metrics.file;
+        }
+        else if (key == "metrics-format") {
+            iss >> config.metrics.format;
+        }
+        else if (key == "metrics-max-bytes") {
+            iss >> config.metrics.max_bytes;
+        }
+        else if (key == "metrics-keep") {
+            iss >> config.metrics.keep_files;
+        }
     }
 
     return config;
 }
+
+Scheduler* createScheduler(const Config& config) {
+    Scheduler* s = new Scheduler(config.num_cpu);
+    s->setSchedulerType(config.scheduler_type);
+    s->setQuantumCycles(config.quantum_cycles);
+    s->setMinInstructions(config.min_instructions);
+    s->setMaxInstructions(config.max_instructions);
+    s->setBatchFrequency(config.batch_frequency);
+    s->setDelay(config.delay_per_exec);
+    s->setMetricsConfig(config.metrics);
+    s->setArrivalConfig(config.arrivals);
+    s->setStatsConfig(config.stats);
+    s->setControlConfig(config.control);
+    s->setWorkloadFile(config.workload_file);
+    s->setAdmissionConfig(config.admission);
+    s->setIoConfig(config.io);
+    s->setArchiveConfig(config.archive);
+    s->setQuantumConfig(config.quantum);
+    s->setExecutionMode(config.execution_mode);
+    s->setPoolThreads(config.pool_threads);
+    s->setAffinityConfig(config.affinity);
+    return s;
+}
+
+// Child instance in sharded mode: run a scheduler and serve the front-end
+int runShard(const std::string& socket_path, const std::filesystem::path& exe_dir) {
+    Config config = readConfig("config.txt", exe_dir);
+    // One stats segment per shard, e.g. csopesy-stats-csopesy-shard-<pid>-0
+    config.stats.segment += "-" + std::filesystem::path(socket_path).stem().string();
+    // Shards are driven by the front-end, not by control-socket clients
+    config.control.socket.clear();
+    if (!config.archive.file.empty()) {
+        config.archive.file += "-" + std::filesystem::path(socket_path).stem().string();
+    }
+    int index = shardIndex(socket_path);
+    Process::setFirstPid(static_cast<uint32_t>(index) * SHARD_PID_RANGE + 1);
+    config.affinity = shardAffinity(config.affinity, index, config.shards);
+    Scheduler* shard = createScheduler(config);
+    cycle_clock.start(std::chrono::microseconds(config.tick_period_us), config.affinity.clock_cpu);
+    shard->start();
+    int result = runShardServer(*shard, socket_path);
+    shard->stop();
+    delete shard;
+    cycle_clock.stop();
+    return result;
+}
+
+void drawShardedScreen(const std::string& processName) {
+    std::string description;
+    std::cout << "Process: " << processName << std::endl;
+    std::cout << "TimeStamp: " << Scheduler::formatTimePoint(std::chrono::system_clock::now()) << std::endl;
+
+    std::string command;
+    while (true) {
+        std::cout << "Type 'exit' to return to main menu, 'process-smi' for info" << std::endl;
+        std::cout << "Enter a command: " << std::flush;
+        std::getline(std::cin, command);
+
+        if (command == "exit") {
+            clearScreen();
+            std::cout << "Back to main menu." << std::endl;
+            break;
+        }
+        else if (command == "process-smi") {
+            if (cluster->queryProcess(processName, description)) {
+                std::cout << description;
+            }
+            else {
+                std::cout << "Process not found." << std::endl;
+            }
+        }
+        else {
+            std::cout << "'" << command << "' command is not recognized. Please enter a correct command." << std::endl;
+        }
+    }
+}
 /*
 void processSMI(Process* p) {
     if (!p) return;
@@ -111,40 +361,44 @@ void processSMI(Process* p) {
     }
 }*/
 
-void processSMI(Process* p) {
-    if (!p) return;
-
-    std::cout << "Process name: " << p->name << std::endl;
-    //std::cout << "ID: " << p->core_id << std::endl;
+// Called through Scheduler::withProcess, with the process table locked
+void processSMI(Process& p) {
+    std::cout << "Process name: " << p.name << std::endl;
+    //std::cout << "ID: " << p.core_id << std::endl;
     std::cout << "Logs:" << std::endl;
 
     // Print log messages
-    auto logs = p->getLogMessages();
+    auto logs = p.getLogMessages();
     for (const auto& log : logs) {
         std::cout << log;
     }
 
-    int remaining = p->remaining_instructions.load();
-    std::cout << "\nCurrent instruction line: " << (p->total_instructions - remaining) << std::endl;
-    std::cout << "Lines of code: " << p->total_instructions << std::endl;
+    int remaining = p.remaining_instructions.load();
+    std::cout << "\nCurrent instruction line: " << (p.total_instructions - remaining) << std::endl;
+    std::cout << "Lines of code: " << p.total_instructions << std::endl;
 
-    if (p->state == ProcessState::Finished) {
+    if (p.state == ProcessState::Finished) {
         std::cout << "\nFinished!" << std::endl;
     }
 }
 
-void viewProcessScreen(const std::string& processName)
-{
-    Process* p = scheduler->getProcess(processName);
-    if (!p) {
-        std::cout << "Process " << processName << " not found. Type 'exit' to return to main menu." << std::endl;
-        return;
+// Same report for a process that has been archived and freed
+void processSMI(const ArchivedProcess& record) {
+    std::cout << "Process name: " << record.name << std::endl;
+    std::cout << "Logs:" << std::endl;
+    for (const auto& log : record.logs) {
+        std::cout << log;
     }
+    std::cout << "\nCurrent instruction line: " << record.total_instructions << std::endl;
+    std::cout << "Lines of code: " << record.total_instructions << std::endl;
+    std::cout << "\nFinished!" << std::endl;
+}
 
+void viewProcessScreen(const std::string& processName)
+{
     // Get log messages from process instead of file
-    std::vector<std::string> logLines = p->getLogMessages();
-
-    p->log_callback = [&](const std::string& message) {
+    std::vector<std::string> logLines;
+    auto callback = [&](const std::string& message) {
         logLines.push_back(message);
         //Re-print for every callback
         clearScreen();
@@ -154,6 +408,14 @@ void viewProcessScreen(const std::string& processName)
         std::cout << "Type 'exit' to return to main menu" << std::endl;
         std::cout << "Enter a command: " << std::flush;
         };
+    bool found = scheduler->withProcess(processName, [&](Process& p) {
+        logLines = p.getLogMessages();
+        p.log_callback = callback;
+    });
+    if (!found) {
+        std::cout << "Process " << processName << " not found. Type 'exit' to return to main menu." << std::endl;
+        return;
+    }
 
     std::string command;
     while (true) {
@@ -167,7 +429,7 @@ void viewProcessScreen(const std::string& processName)
 
         std::getline(std::cin, command);
         if (command == "exit") {
-            p->log_callback = nullptr;
+            scheduler->withProcess(processName, [](Process& p) { p.log_callback = nullptr; });
             clearScreen();
             std::cout << "Back to main menu." << std::endl;
             break;
@@ -179,16 +441,15 @@ void viewProcessScreen(const std::string& processName)
 }
 
 void drawScreen(std::string processName) {
-    Process* p = scheduler->getProcess(processName);
-    if (!p) {
+    bool found = scheduler->withProcess(processName, [](Process& p) {
+        std::cout << "Process: " << p.name << std::endl;
+        int remaining = p.remaining_instructions.load();
+        std::cout << "Instruction: " << (p.total_instructions - remaining)
+            << "/" << p.total_instructions << std::endl;
+    });
+    if (!found) {
         std::cout << "Process: " << processName << " (not found)" << std::endl;
     }
-    else {
-        std::cout << "Process: " << p->name << std::endl;
-        int remaining = p->remaining_instructions.load();
-        std::cout << "Instruction: " << (p->total_instructions - remaining)
-            << "/" << p->total_instructions << std::endl;
-    }
     std::cout << "TimeStamp: " << Scheduler::formatTimePoint(std::chrono::system_clock::now()) << std::endl;
 
     std::string command;
@@ -203,10 +464,14 @@ void drawScreen(std::string processName) {
             break;
         }
         else if (command == "process-smi") {
-            if (p) {
-                processSMI(p);
+            // Looked up again each time: the process may have been archived
+            // and freed since the screen was opened
+            ArchivedProcess record;
+            bool found = scheduler->withProcess(processName, [](Process& p) { processSMI(p); });
+            if (!found && scheduler->getArchived(processName, record)) {
+                processSMI(record);
             }
-            else {
+            else if (!found) {
                 std::cout << "Process not found." << std::endl;
             }
         }
@@ -217,48 +482,50 @@ void drawScreen(std::string processName) {
 }
 
 int main(int argc, char* argv[]) {
-    std::string command;
-    printHeader();
+    // Offline mode: summarize a trace written by trace-start and exit
+    if (argc >= 3 && std::string(argv[1]) == "--analyze-trace") {
+        return analyzeTrace(argv[2], argc >= 4 ? std::stoi(argv[3]) : 72);
+    }
 
     // Store executable directory
     std::filesystem::path exe_dir;
     if (argc > 0) {
         exe_dir = std::filesystem::path(argv[0]).parent_path();
     }
-    /*
-    // Start CPU cycle counter thread
-    std::thread cycle_counter([]() {
-        while (true) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(500));
-            cpu_cycles++;
-        }
-        });
-    */
-
-    std::thread cycle_counter([]() {
-        auto last_time = std::chrono::steady_clock::now();
-        while (true) {
-            auto now = std::chrono::steady_clock::now();
-            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_time);
-            if (elapsed.count() >= 100) { // Update every 100ms
-                cpu_cycles++;
-                last_time = now;
-            }
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        }
-        });
-    cycle_counter.detach();
+
+    // Live monitor: reads the stats segment of a running emulator
+    if (argc >= 2 && std::string(argv[1]) == "--emu-top") {
+        return runEmuTop(argc >= 3 ? argv[2] : StatsConfig().segment, argc >= 4 ? std::stoi(argv[3]) : 0);
+    }
+
+    // Spawned by a sharded front-end: no console, serve requests until told to exit
+    if (argc >= 3 && std::string(argv[1]) == "--shard") {
+        return runShard(argv[2], exe_dir);
+    }
+
+    std::string command;
+    printHeader();
+
+    // Batch settings for the sharded front-end, which has no local scheduler
+    ArrivalConfig shard_arrivals;
+    uint64_t shard_batch_frequency = 1;
 
     while (true) {
         std::cout << "Enter a command: " << std::flush;
         std::getline(std::cin, command);
 
         if (command == "exit") {
+            Tracer::instance().stop();
             if (scheduler) {
                 scheduler->stop();
                 scheduler->stopBatchProcess();
                 delete scheduler;
             }
+            if (cluster) {
+                cluster->stop();
+                delete cluster;
+            }
+            cycle_clock.stop();
             std::cout << "exit command recognized. Closing program." << std::endl;
             break;
         }
@@ -272,18 +539,45 @@ int main(int argc, char* argv[]) {
             else {
                 // Pass executable directory to readConfig
                 Config config = readConfig("config.txt", exe_dir);
-                scheduler = new Scheduler(config.num_cpu);
-                scheduler->setSchedulerType(config.scheduler_type);
-                scheduler->setQuantumCycles(config.quantum_cycles);
-                scheduler->setMinInstructions(config.min_instructions);
-                scheduler->setMaxInstructions(config.max_instructions);
-                scheduler->setBatchFrequency(config.batch_frequency);
-                scheduler->setDelay(config.delay_per_exec);
+                cycle_clock.start(std::chrono::microseconds(config.tick_period_us), config.affinity.clock_cpu);
+                if (config.shards > 0) {
+                    cluster = new ShardCluster();
+                    if (!ipcSupported()) {
+                        std::cout << "Sharded mode needs Unix domain sockets; running a single instance." << std::endl;
+                    }
+                    else if (cluster->start(config.shards, argc > 0 ? argv[0] : "")) {
+                        shard_arrivals = config.arrivals;
+                        shard_batch_frequency = config.batch_frequency;
+                        initialized = true;
+                        std::cout << "Started " << config.shards << " shards with "
+                            << config.num_cpu << " cores each." << std::endl;
+                        if (!config.control.socket.empty()) {
+                            std::cout << "The control socket is not available in sharded mode." << std::endl;
+                        }
+                        continue;
+                    }
+                    else {
+                        std::cout << "Could not start shards; running a single instance." << std::endl;
+                    }
+                    delete cluster;
+                    cluster = nullptr;
+                }
+                scheduler = createScheduler(config);
 
                 scheduler->start();
                 initialized = true;
                 std::cout << "Scheduler initialized with "
                     << config.num_cpu << " cores." << std::endl;
+                if (!config.control.socket.empty()) {
+                    std::cout << "Control socket: " << config.control.socket << std::endl;
+                }
+                if (config.execution_mode == "pool") {
+                    std::cout << "M:N mode: cores multiplexed onto "
+                        << scheduler->getPoolThreadCount() << " host threads." << std::endl;
+                }
+                if (config.affinity.pinned()) {
+                    printAffinityReport();
+                }
             }
         }
         else if (command.starts_with("screen ")) {
@@ -296,17 +590,84 @@ int main(int argc, char* argv[]) {
             std::string base, flag, processName;
             iss >> base >> flag;
 
-            if (flag == "-ls") {
+            if (cluster) {
+                // Sharded: processes live in the shard instances
+                std::string option;
+                iss >> processName >> option;
+                if (!option.empty()) {
+                    std::cout << "Program images are not available in sharded mode." << std::endl;
+                    continue;
+                }
+                std::string description;
+                if (flag == "-ls") {
+                    cluster->writeStatus(std::cout);
+                }
+                else if (flag == "-s" && !processName.empty()) {
+                    int shard = cluster->createProcess(processName);
+                    if (shard == -2) {
+                        std::cout << "Process " << processName << " rejected: shard is at its admission limit." << std::endl;
+                        continue;
+                    }
+                    if (shard < 0) {
+                        std::cout << "Process " << processName << " already exists." << std::endl;
+                        continue;
+                    }
+                    std::cout << "Created new process: " << processName << " on shard " << shard << std::endl;
+                    clearScreen();
+                    std::cout << "Displaying process: " << processName << std::endl;
+                    drawShardedScreen(processName);
+                }
+                else if (flag == "-r" && !processName.empty()) {
+                    if (!cluster->queryProcess(processName, description)
+                        || description.find("Finished!") != std::string::npos) {
+                        std::cout << "Process " << processName << " not found or finished." << std::endl;
+                        continue;
+                    }
+                    clearScreen();
+                    std::cout << "Displaying process: " << processName << std::endl;
+                    drawShardedScreen(processName);
+                }
+                else {
+                    std::cout << "Invalid screen command. Usage: screen -s|-r <name> or screen -ls" << std::endl;
+                }
+            }
+            else if (flag == "-ls") {
                 scheduler->printStatus(false);
             }
             else {
-                iss >> processName;
+                std::string option, imagePath;
+                iss >> processName >> option >> imagePath;
+                if (flag == "-s" && !option.empty() && (option != "--image" || imagePath.empty())) {
+                    std::cout << "Usage: screen -s <name> [--image <file>]" << std::endl;
+                    continue;
+                }
                 if ((flag == "-s" || flag == "-r") && !processName.empty()) {
-                    Process* existingProcess = scheduler->getProcess(processName);
+                    bool finished = false;
+                    bool existingProcess = scheduler->withProcess(processName,
+                        [&](Process& p) { finished = p.state == ProcessState::Finished; });
+                    // Archived processes are finished: their names stay taken
+                    bool archived = !existingProcess && scheduler->isArchived(processName);
 
                     if (flag == "-s") {
                         // Create new process only if it doesn't exist
-                        if (!existingProcess) {
+                        if (!existingProcess && !archived && !imagePath.empty()) {
+                            // Shares the image's validated heap copy; only the position and variables are private
+                            std::string error;
+                            auto program = loadProgramImage(imagePath, error);
+                            if (!program) {
+                                std::cout << "Could not load image " << imagePath << ": " << error << std::endl;
+                                continue;
+                            }
+                            Process* p = new Process(processName, program);
+                            std::string reason;
+                            if (!scheduler->addProcess(p, &reason)) {
+                                delete p;
+                                std::cout << "Process " << processName << " rejected: " << reason << std::endl;
+                                continue;
+                            }
+                            std::cout << "Created new process: " << processName << " from " << imagePath << std::endl;
+                        }
+                        else if (!existingProcess && !archived) {
                             std::random_device rd;
                             std::mt19937 gen(rd());
                             std::uniform_int_distribution<uint64_t> dist(
@@ -315,7 +676,12 @@ int main(int argc, char* argv[]) {
                             );
                             uint64_t instructions = dist(gen);
                             Process* p = new Process(processName, instructions);
-                            scheduler->addProcess(p);
+                            std::string reason;
+                            if (!scheduler->addProcess(p, &reason)) {
+                                delete p;
+                                std::cout << "Process " << processName << " rejected: " << reason << std::endl;
+                                continue;
+                            }
                             std::cout << "Created new process: " << processName << std::endl;
                         }
                         else {
@@ -324,7 +690,7 @@ int main(int argc, char* argv[]) {
                     }
                     else if (flag == "-r") {
                         // For -r, only attach if process exists and is not finished
-                        if (!existingProcess || existingProcess->state == ProcessState::Finished) {
+                        if (!existingProcess || finished) {
                             std::cout << "Process " << processName << " not found or finished." << std::endl;
                             continue;
                         }
@@ -350,7 +716,12 @@ int main(int argc, char* argv[]) {
                 std::cout << "Please run 'initialize' first." << std::endl;
             }
             else {
-                scheduler->startBatchProcess();
+                if (cluster) {
+                    cluster->startBatch(shard_arrivals, shard_batch_frequency);
+                }
+                else if (!scheduler->startBatchProcess()) {
+                    continue;
+                }
                 std::cout << "Scheduler started generating processes." << std::endl;
             }
         }
@@ -359,16 +730,191 @@ int main(int argc, char* argv[]) {
                 std::cout << "Please run 'initialize' first." << std::endl;
             }
             else {
-                scheduler->stopBatchProcess();
+                if (cluster) {
+                    cluster->stopBatch();
+                }
+                else {
+                    scheduler->stopBatchProcess();
+                }
                 std::cout << "Scheduler stopped generating processes." << std::endl;
             }
         }
+        else if (command == "benchmark" || command.starts_with("benchmark ")) {
+            std::istringstream iss(command);
+            std::string base, arg;
+            std::vector<std::string> args;
+            iss >> base;
+            while (iss >> arg) {
+                args.push_back(arg);
+            }
+            runBenchmark(args);
+        }
+        else if (command == "trace-start" || command.starts_with("trace-start ")) {
+            std::istringstream iss(command);
+            std::string base, file;
+            iss >> base >> file;
+            if (file.empty()) {
+                file = "csopesy-trace.bin";
+            }
+            if (trace_enabled) {
+                std::cout << "Tracing already active (" << Tracer::instance().getPath() << ")." << std::endl;
+            }
+            else if (Tracer::instance().start(file)) {
+                std::cout << "Tracing to " << file << std::endl;
+            }
+            else {
+                std::cout << "Could not open trace file " << file << std::endl;
+            }
+        }
+        else if (command == "trace-stop") {
+            if (!trace_enabled) {
+                std::cout << "Tracing is not active." << std::endl;
+            }
+            else {
+                Tracer& tracer = Tracer::instance();
+                tracer.stop();
+                std::cout << "Trace saved to " << tracer.getPath() << ": " << tracer.getWrittenCount()
+                    << " events, " << tracer.getDroppedCount() << " dropped." << std::endl;
+                std::cout << "Analyze with: os-emulator --analyze-trace " << tracer.getPath() << std::endl;
+            }
+        }
+        else if (command.starts_with("image-build ")) {
+            std::istringstream iss(command);
+            std::string base, source, image, error;
+            iss >> base >> source >> image;
+            if (image.empty()) {
+                std::cout << "Usage: image-build <source> <image>" << std::endl;
+                continue;
+            }
+            auto program = assembleProgram(source, error);
+            if (!program || !writeProgramImage(*program, image, error)) {
+                std::cout << "image-build: " << error << std::endl;
+                continue;
+            }
+            std::cout << "Wrote " << image << ": " << program->source_lines << " instructions, "
+                << program->code.size() << " ops, " << program->constants.size() << " strings, "
+                << program->var_names.size() << " variables." << std::endl;
+            std::cout << "Run with: screen -s <name> --image " << image << std::endl;
+        }
+        else if (command == "clock-stat") {
+            cycle_clock.printStats();
+        }
+        else if (command == "profile") {
+            printProfile();
+        }
+        else if (command == "profile-start") {
+            if (!profiling_enabled) {
+                std::cout << "Profiling was compiled out (EMU_ENABLE_PROFILING=0)." << std::endl;
+            }
+            else {
+                resetProfile();
+                profiling_active = true;
+                std::cout << "Profiling started." << std::endl;
+            }
+        }
+        else if (command == "profile-stop") {
+            profiling_active = false;
+            std::cout << "Profiling stopped; 'profile' shows what was collected." << std::endl;
+        }
+        else if (command == "lock-stat") {
+            printLockStats();
+        }
+        else if (command == "lock-stat-start") {
+            if (!lock_stats_enabled) {
+                std::cout << "Lock statistics were compiled out (EMU_ENABLE_LOCK_STATS=0)." << std::endl;
+            }
+            else {
+                resetLockStats();
+                lock_stats_active = true;
+                std::cout << "Collecting lock statistics." << std::endl;
+            }
+        }
+        else if (command == "lock-stat-stop") {
+            lock_stats_active = false;
+            std::cout << "Lock statistics stopped; 'lock-stat' shows what was collected." << std::endl;
+        }
+        else if (command == "generator-stat") {
+            if (!initialized) {
+                std::cout << "Please run 'initialize' first." << std::endl;
+            }
+            else if (cluster) {
+                std::cout << "Generator statistics are kept per shard and not available in sharded mode." << std::endl;
+            }
+            else {
+                scheduler->printGeneratorStats();
+            }
+        }
+        else if (command == "admission-stat") {
+            if (!initialized) {
+                std::cout << "Please run 'initialize' first." << std::endl;
+            }
+            else if (cluster) {
+                std::cout << "Admission statistics are kept per shard and not available in sharded mode." << std::endl;
+            }
+            else {
+                scheduler->printAdmissionStats();
+            }
+        }
+        else if (command == "mem-stat" || command.starts_with("mem-stat ")) {
+            // mem-stat [top-n]
+            std::istringstream iss(command.substr(8));
+            size_t top = 10;
+            iss >> top;
+            if (!initialized) {
+                std::cout << "Please run 'initialize' first." << std::endl;
+            }
+            else if (cluster) {
+                std::cout << "Memory statistics are kept per shard and not available in sharded mode." << std::endl;
+            }
+            else {
+                scheduler->printMemoryStats(top);
+            }
+        }
+        else if (command == "quantum-stat") {
+            if (!initialized) {
+                std::cout << "Please run 'initialize' first." << std::endl;
+            }
+            else if (cluster) {
+                std::cout << "Quantum statistics are kept per shard and not available in sharded mode." << std::endl;
+            }
+            else {
+                scheduler->printQuantumStats();
+            }
+        }
+        else if (command == "affinity-stat") {
+            if (!initialized) {
+                std::cout << "Please run 'initialize' first." << std::endl;
+            }
+            else if (cluster) {
+                std::cout << "Thread placement is kept per shard and not available in sharded mode." << std::endl;
+            }
+            else {
+                printAffinityReport();
+            }
+        }
+        else if (command == "io-stat") {
+            if (!initialized) {
+                std::cout << "Please run 'initialize' first." << std::endl;
+            }
+            else if (cluster) {
+                std::cout << "I/O statistics are kept per shard and not available in sharded mode." << std::endl;
+            }
+            else {
+                scheduler->printIoStats();
+            }
+        }
         else if (command == "report-util") {
             if (!initialized) {
                 std::cout << "Please run 'initialize' first." << std::endl;
             }
             else {
-                scheduler->printStatus(true);
+                if (cluster) {
+                    std::ofstream report("csopesy-log.txt");
+                    cluster->writeStatus(report);
+                }
+                else {
+                    scheduler->printStatus(true);
+                }
                 std::cout << "Report saved to csopesy-log.txt" << std::endl;
             }
         }
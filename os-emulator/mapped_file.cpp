@@ -0,0 +1,101 @@
+#include "mapped_file.h"
+#include <algorithm>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+bool MappedFile::open(const std::string& path) {
+    close();
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(handle, &file_size)) {
+        CloseHandle(handle);
+        return false;
+    }
+    length = static_cast<size_t>(file_size.QuadPart);
+    if (length > 0) {
+        HANDLE view = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!view) {
+            CloseHandle(handle);
+            return false;
+        }
+        address = static_cast<const char*>(MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0));
+        if (!address) {
+            CloseHandle(view);
+            CloseHandle(handle);
+            return false;
+        }
+        mapping = view;
+    }
+    file = handle;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) < 0) {
+        ::close(fd);
+        return false;
+    }
+    length = static_cast<size_t>(info.st_size);
+    // mmap rejects zero-length mappings; an empty file is simply empty
+    if (length > 0) {
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            ::close(fd);
+            length = 0;
+            return false;
+        }
+        address = static_cast<const char*>(mapped);
+    }
+    ::close(fd);
+#endif
+    opened = true;
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (address) UnmapViewOfFile(address);
+    if (mapping) CloseHandle(mapping);
+    if (file) CloseHandle(file);
+    mapping = nullptr;
+    file = nullptr;
+#else
+    if (address) munmap(const_cast<char*>(address), length);
+#endif
+    address = nullptr;
+    length = 0;
+    opened = false;
+}
+
+void MappedFile::adviseSequential() {
+#ifndef _WIN32
+    if (address) madvise(const_cast<char*>(address), length, MADV_SEQUENTIAL);
+#endif
+}
+
+void MappedFile::release(size_t offset, size_t bytes) {
+#ifdef _WIN32
+    (void)offset;
+    (void)bytes;
+#else
+    if (!address || offset >= length) return;
+    // madvise works on whole pages; shrink the range inward to page bounds
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t begin = (offset + page - 1) / page * page;
+    size_t end = std::min(offset + bytes, length) / page * page;
+    if (end > begin) {
+        madvise(const_cast<char*>(address) + begin, end - begin, MADV_DONTNEED);
+    }
+#endif
+}
@@ -0,0 +1,38 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. Pages are faulted in on first
+// touch, so opening a multi-gigabyte file costs nothing up front.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    const char* data() const { return address; }
+    size_t size() const { return length; }
+    bool isOpen() const { return opened; }
+
+    // Hints for streaming readers: read ahead aggressively, and drop pages
+    // that have been consumed so resident memory stays flat
+    void adviseSequential();
+    void release(size_t offset, size_t bytes);
+
+private:
+    const char* address = nullptr;
+    size_t length = 0;
+    bool opened = false;
+#ifdef _WIN32
+    void* file = nullptr;
+    void* mapping = nullptr;
+#endif
+};
+
+#endif // MAPPED_FILE_H
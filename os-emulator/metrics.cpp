@@ -0,0 +1,136 @@
+#include "metrics.h"
+#include "scheduler.h"
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+
+namespace {
+    constexpr size_t FLUSH_BYTES = 64 * 1024;
+    constexpr auto FLUSH_INTERVAL = std::chrono::seconds(1);
+}
+
+MetricsSampler::~MetricsSampler() {
+    stop();
+}
+
+void MetricsSampler::start(Scheduler* s, const MetricsConfig& cfg) {
+    if (running || cfg.interval_cycles == 0) return;
+    scheduler = s;
+    config = cfg;
+    stop_requested = false;
+    openFile();
+    if (!out.is_open()) {
+        std::cerr << "Error: Could not open metrics file: " << config.file << std::endl;
+        return;
+    }
+    running = true;
+    thread = std::thread(&MetricsSampler::run, this);
+}
+
+void MetricsSampler::stop() {
+    if (!running) return;
+    stop_requested = true;
+    if (thread.joinable()) {
+        thread.join();
+    }
+    flush();
+    out.close();
+    running = false;
+}
+
+void MetricsSampler::run() {
+    auto last_flush = std::chrono::steady_clock::now();
+    uint64_t next_cycle = cpu_cycles + config.interval_cycles;
+
+    while (!stop_requested) {
+        while (cpu_cycles < next_cycle && !stop_requested) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (stop_requested) break;
+
+        append(scheduler->sampleMetrics());
+        next_cycle += config.interval_cycles;
+        // If we fell behind (slow disk, huge queue), skip to the next
+        // boundary instead of emitting a burst of identical rows.
+        uint64_t now_cycle = cpu_cycles;
+        if (next_cycle <= now_cycle) {
+            next_cycle = now_cycle + config.interval_cycles;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (buffer.size() >= FLUSH_BYTES || now - last_flush >= FLUSH_INTERVAL) {
+            flush();
+            last_flush = now;
+        }
+    }
+}
+
+void MetricsSampler::append(const MetricsSample& s) {
+    float utilization = s.num_cores > 0
+        ? (static_cast<float>(s.active_cores) / s.num_cores) * 100.0f : 0.0f;
+
+    if (config.format == "jsonl") {
+        buffer += "{\"cycle\":" + std::to_string(s.cycle)
+            + ",\"time_ms\":" + std::to_string(s.timestamp_ms)
+            + ",\"utilization\":" + std::to_string(utilization)
+            + ",\"active_cores\":" + std::to_string(s.active_cores)
+            + ",\"queue_depth\":" + std::to_string(s.queue_depth)
+            + ",\"running\":" + std::to_string(s.running)
+            + ",\"finished\":" + std::to_string(s.finished)
+            + ",\"instructions\":" + std::to_string(s.instructions)
+            + ",\"dispatches\":" + std::to_string(s.dispatches)
+            + ",\"preemptions\":" + std::to_string(s.preemptions) + "}\n";
+    }
+    else {
+        buffer += std::to_string(s.cycle) + ","
+            + std::to_string(s.timestamp_ms) + ","
+            + std::to_string(utilization) + ","
+            + std::to_string(s.active_cores) + ","
+            + std::to_string(s.queue_depth) + ","
+            + std::to_string(s.running) + ","
+            + std::to_string(s.finished) + ","
+            + std::to_string(s.instructions) + ","
+            + std::to_string(s.dispatches) + ","
+            + std::to_string(s.preemptions) + "\n";
+    }
+}
+
+void MetricsSampler::flush() {
+    if (buffer.empty() || !out.is_open()) return;
+    if (file_bytes > 0 && file_bytes + buffer.size() > config.max_bytes) {
+        rotate();
+    }
+    out.write(buffer.data(), buffer.size());
+    out.flush();
+    file_bytes += buffer.size();
+    buffer.clear();
+}
+
+void MetricsSampler::openFile() {
+    std::error_code ec;
+    file_bytes = std::filesystem::exists(config.file, ec)
+        ? std::filesystem::file_size(config.file, ec) : 0;
+    out.open(config.file, std::ios::app | std::ios::binary);
+    if (out.is_open() && file_bytes == 0 && config.format != "jsonl") {
+        std::string header = "cycle,time_ms,utilization,active_cores,queue_depth,"
+            "running,finished,instructions,dispatches,preemptions\n";
+        out << header;
+        file_bytes = header.size();
+    }
+}
+
+void MetricsSampler::rotate() {
+    out.close();
+    std::error_code ec;
+    for (int i = config.keep_files - 1; i >= 1; i--) {
+        std::filesystem::rename(config.file + "." + std::to_string(i),
+            config.file + "." + std::to_string(i + 1), ec);
+    }
+    if (config.keep_files > 0) {
+        std::filesystem::rename(config.file, config.file + ".1", ec);
+    }
+    else {
+        std::filesystem::remove(config.file, ec);
+    }
+    openFile();
+}
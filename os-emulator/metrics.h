@@ -0,0 +1,63 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <cstdint>
+
+class Scheduler;
+
+struct MetricsConfig {
+    uint64_t interval_cycles = 0;           // 0 disables the sampler
+    std::string file = "csopesy-metrics.csv";
+    std::string format = "csv";             // "csv" or "jsonl"
+    uint64_t max_bytes = 10 * 1024 * 1024;  // rotate once the file reaches this size
+    int keep_files = 3;                     // rotated files kept as <file>.1 .. <file>.N
+};
+
+struct MetricsSample {
+    uint64_t cycle = 0;
+    int64_t timestamp_ms = 0;
+    int num_cores = 0;
+    int active_cores = 0;
+    int queue_depth = 0;
+    int running = 0;
+    uint64_t finished = 0;
+    uint64_t instructions = 0;
+    uint64_t dispatches = 0;
+    uint64_t preemptions = 0;
+};
+
+// Background thread that samples scheduler counters every N cycles and
+// appends them to a rotating file. Rows are buffered in memory and written
+// in chunks so neither the REPL nor the cores ever wait on disk I/O.
+class MetricsSampler {
+public:
+    MetricsSampler() = default;
+    ~MetricsSampler();
+
+    void start(Scheduler* scheduler, const MetricsConfig& config);
+    void stop();
+    bool isRunning() const { return running; }
+
+private:
+    Scheduler* scheduler = nullptr;
+    MetricsConfig config;
+    std::thread thread;
+    std::atomic<bool> running{ false };
+    std::atomic<bool> stop_requested{ false };
+
+    std::ofstream out;
+    std::string buffer;
+    uint64_t file_bytes = 0;
+
+    void run();
+    void append(const MetricsSample& sample);
+    void flush();
+    void openFile();
+    void rotate();
+};
+
+#endif // METRICS_H
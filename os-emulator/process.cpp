@@ -6,65 +6,77 @@
 #include <random>
 #include <algorithm>
 #include <iostream>
+#include "trace.h"
+#include "profiler.h"
+#include "ipc.h"
+
+// Binds the shared instruction semantics in program.h to this process
+struct Process::Env {
+    Process& process;
+    int core_id;
+
+    uint16_t& var(uint8_t slot) { return process.variables[slot]; }
+    void print(uint16_t constant) {
+        process.logPrint(process.program->constants[constant], core_id,
+            std::chrono::system_clock::now());
+    }
+    void sleep(uint8_t ticks) {
+        process.sleep_until = cpu_cycles + ticks;
+        traceEvent(TraceEventType::Sleep, core_id, process.pid);
+    }
+    void io(bool write, uint8_t device, uint16_t kb) {
+        process.io_requests.push_back({ device, write, kb });
+    }
+};
+
+static std::atomic<uint32_t> next_pid{ 1 };
+
+LockCounters& Process::logCounters() {
+    static LockCounters& counters = lockCounters("process.log");
+    return counters;
+}
+
+void Process::setFirstPid(uint32_t pid) {
+    next_pid = pid;
+}
 
-Process::Process(const std::string& name, int total_instructions)
-    : name(name), total_instructions(total_instructions),
+Process::Process(const std::string& name, int total_instructions, InstructionMix mix)
+    : name(name), pid(next_pid++), total_instructions(total_instructions),
     remaining_instructions(total_instructions),
     state(ProcessState::Waiting), core_id(-1)
     //start_time(std::chrono::system_clock::now()),
     //log_file_name(name + ".log") 
 {
     quantum_counter = 0;
-    generateRandomInstructions();
+    generateRandomInstructions(mix);
 }
 
-void Process::generateRandomInstructions() {
+Process::Process(const std::string& name, std::shared_ptr<const Program> program)
+    : name(name), pid(next_pid++), total_instructions(static_cast<int>(program->source_lines)),
+    remaining_instructions(static_cast<int>(program->source_lines)),
+    state(ProcessState::Waiting), core_id(-1)
+{
+    quantum_counter = 0;
+    setProgram(std::move(program));
+}
+
+void Process::generateRandomInstructions(InstructionMix mix) {
     std::random_device rd;
     std::mt19937 gen(rd());
-    std::uniform_int_distribution<uint16_t> value_dist(0, 100);
-    std::uniform_int_distribution<uint16_t> value_dist_uint8(0, 100);
-    std::uniform_int_distribution<int> op_dist(0, 5);
-
-    for (int i = 0; i < total_instructions; i++) {
-        Instruction instr;
-        switch (op_dist(gen)) {
-        case 0: // PRINT
-            instr.type = "PRINT";
-            instr.operands.push_back("Hello world from " + name + "!");
-            break;
-        case 1: // DECLARE
-            instr.type = "DECLARE";
-            instr.operands.push_back("var" + std::to_string(i % 10));
-            instr.operands.push_back(value_dist(gen));
-            break;
-        case 2: // ADD
-            instr.type = "ADD";
-            instr.operands.push_back("var" + std::to_string(i % 10));
-            instr.operands.push_back("var" + std::to_string((i + 1) % 10));
-            instr.operands.push_back(value_dist(gen));
-            break;
-        case 3: // SUBTRACT
-            instr.type = "SUBTRACT";
-            instr.operands.push_back("var" + std::to_string(i % 10));
-            instr.operands.push_back("var" + std::to_string((i + 1) % 10));
-            instr.operands.push_back(value_dist(gen));
-            break;
-        case 4: // SLEEP
-            instr.type = "SLEEP";
-            instr.operands.push_back(static_cast<uint8_t>(value_dist_uint8(gen) % 10 + 1));
-            break;
-        case 5: // FOR
-            instr.type = "FOR";
-            instr.operands.push_back(static_cast<uint16_t>(3)); // Repeat count
-            // The next instruction will be treated as the loop body
-            break;
-        }
-        instructions.push_back(instr);
-    }
+    setProgram(generateProgram(name, total_instructions, mix, gen));
+}
+
+void Process::setProgram(std::shared_ptr<const Program> compiled) {
+    program = std::move(compiled);
+    code = program->ops();
+    code_size = program->opCount();
+    variables.assign(program->var_names.size(), 0);
+    current_instruction = 0;
 }
 
 bool Process::executeNextInstruction(int core_id) {
-    if (current_instruction >= instructions.size()) {
+    ProfileScope profile(ProfileZone::Execute);
+    if (current_instruction >= code_size) {
         state = ProcessState::Finished;
         end_time = std::chrono::system_clock::now();
         return true;
@@ -78,105 +90,103 @@ bool Process::executeNextInstruction(int core_id) {
     else if (sleep_until > 0) {
         sleep_until = 0;  // Wake up if sleep time has passed
     }
-	/*
-	else {
-        sleep_until = 0;  // Wake up if sleep time has passed
-    }*/
-
-    auto& instr = instructions[current_instruction++];
-
-    // note: best to test with only 1 process running, use screen -s
-    auto executeInstruction = [&](const Instruction& instr) {
-        if (instr.type == "PRINT") {
-            std::string message = std::get<std::string>(instr.operands[0]);
-            logPrint(message, core_id, std::chrono::system_clock::now());
-        }
-        else if (instr.type == "DECLARE") {
-            std::string var = std::get<std::string>(instr.operands[0]);
-            uint16_t value = std::get<uint16_t>(instr.operands[1]);
-            declareVariable(var, value);
-            /*Temp Test Print
-            std::cout << "DECLARE" << std::endl;
-            std::cout << std::get<std::string>(instr.operands[0]) << "=" << std::get<std::uint16_t>(instr.operands[1]) << std::endl;
-            std::cout << var << "=" << value << std::endl;*/
-        }
-        else if (instr.type == "ADD") {
-            std::string dest = std::get<std::string>(instr.operands[0]);
-            uint16_t op1 = getOperandValue(instr.operands[1]);
-            uint16_t op2 = getOperandValue(instr.operands[2]);
-            declareVariable(dest, op1 + op2);
-            /*Temp Test Print
-            std::cout << "ADD" << std::endl;
-            std::cout << getOperandValue(instr.operands[1]) << "+" << getOperandValue(instr.operands[2]) << ":" << getOperandValue(instr.operands[0]) << std::endl;
-            std::cout << op1 << "+" << op2 << "=" << getOperandValue(instr.operands[0]) << std::endl;*/
-        }
-        else if (instr.type == "SUBTRACT") {
-            std::string dest = std::get<std::string>(instr.operands[0]);
-            uint16_t op1 = getOperandValue(instr.operands[1]);
-            uint16_t op2 = getOperandValue(instr.operands[2]);
-            declareVariable(dest, std::max(0, static_cast<int>(op1 - op2)));
-            /*Temp Test Print
-            std::cout << "SUB" << std::endl;
-            std::cout << getOperandValue(instr.operands[1]) << "-" << getOperandValue(instr.operands[2]) << ":" << getOperandValue(instr.operands[0]) << std::endl;
-            std::cout << op1 << "-" << op2 << "=" << getOperandValue(instr.operands[0]) << std::endl;*/
-        }
-        else if (instr.type == "SLEEP") {
-            uint8_t ticks = static_cast<uint8_t>(std::get<uint16_t>(instr.operands[0]));
-            sleep_until = cpu_cycles + ticks;
-            /*Temp Test Print
-            std::cout << "SLEEP for " << static_cast<int>(ticks) << std::endl;
-            return true; //true for sleep */
-        }
-        return false;
-    };
-
-    try {
-        if (executeInstruction(instr)) {
-            return false; // stop if sleep
-        }
-
-        if (instr.type == "FOR") {
-            uint16_t repeats = std::get<uint16_t>(instr.operands[0]);
-            size_t loop_start = current_instruction;
-            for (uint16_t i = 0; i < repeats; i++) {
-                current_instruction = loop_start;
-                if (current_instruction >= instructions.size()) break;
-                /*Temp Test Print
-                std::cout << "FOR " << (i+1) << ": " << instructions[current_instruction++].type << std::endl;*/
-
-                auto& nested_instr = instructions[current_instruction++];
-                if (executeInstruction(nested_instr)) {
-                    break; // exit if sleep
-                }
-            }
-        }
-    }
-    catch (const std::bad_variant_access& e) {
-        std::cerr << "Error executing instruction: " << e.what() << std::endl;
-    }
 
-    remaining_instructions--;
+    // One statement per call: a single op, or a FOR nest run to completion
+    size_t pc = current_instruction;
+    Env env{ *this, core_id };
+    traceEvent(TraceEventType::Execute, core_id, pid, static_cast<uint8_t>(code[pc].code));
+    remaining_instructions -= static_cast<int>(statementLines(code, pc));
+    current_instruction = executeStatement(code, pc, env);
     return false;
 }
 
-uint16_t Process::getOperandValue(const Value& operand) const {
-    if (std::holds_alternative<uint16_t>(operand)) {
-        return std::get<uint16_t>(operand);
+std::string Process::serialize() {
+    ByteWriter out;
+    out.putString(name);
+    out.put<uint32_t>(pid);
+    out.put<int32_t>(remaining_instructions);
+    out.put<uint64_t>(current_instruction);
+    uint64_t now = cpu_cycles;
+    out.put<uint64_t>(sleep_until > now ? sleep_until - now : 0);
+    out.put<int64_t>(start_time.time_since_epoch().count());
+    out.putArray(program->ops(), program->opCount());
+    out.putStrings(program->constants);
+    out.putStrings(program->var_names);
+    out.put<uint64_t>(program->source_lines);
+    out.putVector(variables);
+    out.putStrings(getLogMessages());
+    return out.data();
+}
+
+Process* Process::deserialize(const std::string& bytes) {
+    ByteReader in(bytes);
+    std::string name = in.getString();
+    uint32_t pid = in.get<uint32_t>();
+    int32_t remaining = in.get<int32_t>();
+    uint64_t position = in.get<uint64_t>();
+    uint64_t sleep_ticks = in.get<uint64_t>();
+    int64_t started = in.get<int64_t>();
+
+    auto program = std::make_shared<Program>();
+    program->code = in.getVector<Op>();
+    program->constants = in.getStrings();
+    program->var_names = in.getStrings();
+    program->source_lines = in.get<uint64_t>();
+    std::vector<uint16_t> variables = in.getVector<uint16_t>();
+    std::vector<std::string> logs = in.getStrings();
+    if (!in.ok() || position > program->code.size()
+        || variables.size() != program->var_names.size()) {
+        return nullptr;
+    }
+
+    Process* p = new Process(name, program);
+    // Keeps its pid across instances; shards allocate from disjoint ranges
+    p->pid = pid;
+    p->remaining_instructions = remaining;
+    p->current_instruction = position;
+    p->sleep_until = sleep_ticks > 0 ? cpu_cycles + sleep_ticks : 0;
+    p->start_time = std::chrono::system_clock::time_point(
+        std::chrono::system_clock::duration(started));
+    p->variables = std::move(variables);
+    p->log_messages = std::move(logs);
+    return p;
+}
+
+size_t Process::estimateFootprint() const {
+    size_t bytes = sizeof(Process) + stringHeapBytes(name) + variables.capacity() * sizeof(uint16_t);
+    if (program && program->image_path.empty()) {
+        bytes += program->heapBytes();
+    }
+    return bytes;
+}
+
+ProcessMemory Process::measureMemory() {
+    ProcessMemory memory;
+    if (program) {
+        // use_count includes this process, so it is at least 1
+        memory.program = program->heapBytes() / static_cast<size_t>(program.use_count());
+    }
+    memory.variables = variables.capacity() * sizeof(uint16_t);
+    memory.bookkeeping = sizeof(Process) + stringHeapBytes(name);
+
+    std::lock_guard<InstrumentedMutex> lock(log_mutex);
+    memory.logs = log_messages.capacity() * sizeof(std::string);
+    for (const auto& message : log_messages) {
+        memory.logs += stringHeapBytes(message);
     }
-    std::string var = std::get<std::string>(operand);
-    auto it = variables.find(var);
-    return it != variables.end() ? it->second : 0;
+    return memory;
 }
 
 void Process::declareVariable(const std::string& name, uint16_t value) {
-    variables[name] = std::min(value, static_cast<uint16_t>(65535));
-    /*Temp Test Print
-    std::cout << "Variable declared to: " << name << "=" << value << std::endl;*/
+    int slot = program->findVariable(name);
+    if (slot >= 0) {
+        variables[slot] = value;
+    }
 }
 
 uint16_t Process::getVariableValue(const std::string& name) const {
-    auto it = variables.find(name);
-    return it != variables.end() ? it->second : 0;
+    int slot = program->findVariable(name);
+    return slot >= 0 ? variables[slot] : 0;
 }
 /*
 Process::~Process() {
@@ -194,7 +204,8 @@ void Process::openLogFile() {
 void Process::logPrint(const std::string& message, int core,
     const std::chrono::system_clock::time_point& time)
 {
-    std::lock_guard<std::mutex> lock(log_mutex);
+    ProfileScope profile(ProfileZone::LogPrint);
+    std::lock_guard<InstrumentedMutex> lock(log_mutex);
     auto zt = std::chrono::zoned_time{ std::chrono::current_zone(),
         std::chrono::time_point_cast<std::chrono::seconds>(time) };
     std::string log_line = "(" + std::format("{:%m/%d/%Y %I:%M:%S%p}", zt) +
@@ -210,6 +221,6 @@ void Process::logPrint(const std::string& message, int core,
 }
 
 std::vector<std::string> Process::getLogMessages() {
-	std::lock_guard<std::mutex> lock(log_mutex);
+	std::lock_guard<InstrumentedMutex> lock(log_mutex);
 	return log_messages;
 }
@@ -7,20 +7,35 @@
 #include <fstream>
 #include <mutex>
 #include <vector>
-#include <map>
-#include <variant>
+#include <memory>
 #include <functional>
+#include "program.h"
+#include "io.h"
+#include "lock_stats.h"
+#include "quantum.h"
 
-enum class ProcessState { Waiting, Running, Finished };
+// Blocked: off-core waiting for I/O completions
+enum class ProcessState { Waiting, Running, Finished, Blocked };
 
-using Value = std::variant<uint16_t, std::string>;
+// Host memory held by one process, in bytes. program is this process's
+// share of its compiled program: a program used by n processes is split n
+// ways, so summing over processes counts each program once.
+struct ProcessMemory {
+    size_t program = 0;
+    size_t variables = 0;
+    size_t logs = 0;
+    size_t bookkeeping = 0;     // the Process object and its name
+    size_t total() const { return program + variables + logs + bookkeeping; }
+};
 
 extern std::atomic<uint64_t> cpu_cycles;
 extern std::atomic<uint64_t> quantum_counter;
 
 class Process {
 public:
-    Process(const std::string& name, int total_instructions);
+    Process(const std::string& name, int total_instructions,
+        InstructionMix mix = InstructionMix::Mixed);
+    Process(const std::string& name, std::shared_ptr<const Program> program);
     //~Process();
 
     void logPrint(const std::string& message, int core,
@@ -29,15 +44,34 @@ public:
 
     // Instruction execution
     bool executeNextInstruction(int core_id);
-    void generateRandomInstructions();
+    void generateRandomInstructions(InstructionMix mix = InstructionMix::Mixed);
 
     // Variable operations
     void declareVariable(const std::string& name, uint16_t value);
     uint16_t getVariableValue(const std::string& name) const;
     uint64_t getSleepUntil() const { return sleep_until.load(); }
+
+    // Migration between emulator instances. Sleeps are carried as the ticks
+    // still remaining, since each instance runs its own cycle clock.
+    std::string serialize();
+    static Process* deserialize(const std::string& bytes);
+    // Where this instance starts numbering pids, so shards never collide
+    static void setFirstPid(uint32_t pid);
     bool isSleeping() const { return sleep_until > 0 && cpu_cycles < sleep_until; }
+    // READ/WRITE requests issued by the last statement; the core hands them
+    // to the I/O subsystem and parks the process until they complete
+    bool hasPendingIo() const { return !io_requests.empty(); }
+    // Every statement has run; the next executeNextInstruction reports it
+    bool isDone() const { return current_instruction >= code_size; }
+    std::vector<IoRequest> takeIoRequests() { return std::move(io_requests); }
+    // Bytes held by this process and its private program, for admission
+    // control; shared image code is not counted
+    size_t estimateFootprint() const;
+    ProcessMemory measureMemory();
+    const Program* getProgram() const { return program.get(); }
 
     std::string name;
+    uint32_t pid;
     int total_instructions;
     std::atomic<int> remaining_instructions;
     std::atomic<ProcessState> state;
@@ -45,23 +79,31 @@ public:
     std::chrono::system_clock::time_point start_time;
     std::chrono::system_clock::time_point end_time;
     std::function<void(const std::string&)> log_callback;
+    uint64_t admitted_bytes = 0;    // charged by AdmissionController
+    std::atomic<QuantumClass> quantum_class{ QuantumClass::Interactive };
+    std::chrono::steady_clock::time_point queued_at;   // set under the queue lock
 
 private:
-    struct Instruction {
-        std::string type;
-        std::vector<Value> operands;
-    };
+    friend class SimdBatchEngine;
+
+    struct Env;
 
     std::vector<std::string> log_messages;
-    std::mutex log_mutex;
+    // One per process, so the shared counters are looked up only once
+    static LockCounters& logCounters();
+    InstrumentedMutex log_mutex{ logCounters() };
 
-    // Process memory and instructions
-    std::map<std::string, uint16_t> variables;
-    std::vector<Instruction> instructions;
+    // Process memory and instructions. The compiled program may be shared
+    // between processes; each keeps only its own variables and position.
+    std::shared_ptr<const Program> program;
+    const Op* code = nullptr;
+    size_t code_size = 0;
+    std::vector<uint16_t> variables;
     std::atomic<size_t> current_instruction{ 0 };
     std::atomic<uint64_t> sleep_until{ 0 };
+    std::vector<IoRequest> io_requests;
 
     //void openLogFile();
-    uint16_t getOperandValue(const Value& operand) const;
+    void setProgram(std::shared_ptr<const Program> program);
 };
 #endif // PROCESS_H
\ No newline at end of file
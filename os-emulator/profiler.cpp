@@ -0,0 +1,209 @@
+#include "profiler.h"
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <bit>
+#include <algorithm>
+
+std::atomic<bool> profiling_active{ false };
+
+namespace {
+    constexpr int ZONE_COUNT = static_cast<int>(ProfileZone::Count);
+
+    const char* zoneName(int zone) {
+        static const char* names[] = {
+            "execute", "logPrint", "dispatch", "preempt", "addProcess", "printStatus"
+        };
+        return names[zone];
+    }
+
+    struct ZoneCounters {
+        uint64_t calls = 0;
+        uint64_t total_ns = 0;
+        uint64_t buckets[PROFILE_BUCKETS] = {};
+    };
+
+    // Written only by the owning thread (plain load + store, no RMW); read
+    // by printProfile. A reset moves the baseline instead of clearing the
+    // counters, so it never races with the owner.
+    struct ThreadProfile {
+        std::atomic<uint64_t> calls[ZONE_COUNT] = {};
+        std::atomic<uint64_t> total_ns[ZONE_COUNT] = {};
+        std::atomic<uint64_t> buckets[ZONE_COUNT][PROFILE_BUCKETS] = {};
+        ZoneCounters baseline[ZONE_COUNT];
+    };
+
+    std::mutex registry_mutex;
+    // Profiles of running threads
+    std::vector<std::unique_ptr<ThreadProfile>>& registry() {
+        static auto* profiles = new std::vector<std::unique_ptr<ThreadProfile>>();
+        return *profiles;
+    }
+
+    // Exited threads folded together, so short-lived threads (control
+    // socket clients, benchmark schedulers) still count without each one
+    // keeping an entry. Written under registry_mutex.
+    ThreadProfile& retired() {
+        static auto* profile = new ThreadProfile();
+        return *profile;
+    }
+    int retired_threads[ZONE_COUNT] = {};  // exited with calls since the last reset
+
+    void bump(std::atomic<uint64_t>& counter, uint64_t amount) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    void retire(ThreadProfile* profile) {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        ThreadProfile& into = retired();
+        for (int z = 0; z < ZONE_COUNT; z++) {
+            if (profile->calls[z].load(std::memory_order_relaxed) > profile->baseline[z].calls) {
+                retired_threads[z]++;
+            }
+            bump(into.calls[z], profile->calls[z].load(std::memory_order_relaxed));
+            bump(into.total_ns[z], profile->total_ns[z].load(std::memory_order_relaxed));
+            into.baseline[z].calls += profile->baseline[z].calls;
+            into.baseline[z].total_ns += profile->baseline[z].total_ns;
+            for (int b = 0; b < PROFILE_BUCKETS; b++) {
+                bump(into.buckets[z][b], profile->buckets[z][b].load(std::memory_order_relaxed));
+                into.baseline[z].buckets[b] += profile->baseline[z].buckets[b];
+            }
+        }
+        auto& profiles = registry();
+        profiles.erase(std::find_if(profiles.begin(), profiles.end(),
+            [&](const std::unique_ptr<ThreadProfile>& p) { return p.get() == profile; }));
+    }
+
+    // Registers the thread's profile on first use and retires it at thread exit
+    struct ThreadProfileHandle {
+        ThreadProfile* profile = nullptr;
+        ~ThreadProfileHandle() {
+            if (profile) retire(profile);
+        }
+    };
+
+    ThreadProfile& threadProfile() {
+        static thread_local ThreadProfileHandle handle;
+        if (!handle.profile) {
+            auto created = std::make_unique<ThreadProfile>();
+            handle.profile = created.get();
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            registry().push_back(std::move(created));
+        }
+        return *handle.profile;
+    }
+
+    ZoneCounters current(const ThreadProfile& profile, int z) {
+        ZoneCounters now;
+        now.calls = profile.calls[z].load(std::memory_order_relaxed);
+        now.total_ns = profile.total_ns[z].load(std::memory_order_relaxed);
+        for (int b = 0; b < PROFILE_BUCKETS; b++) {
+            now.buckets[b] = profile.buckets[z][b].load(std::memory_order_relaxed);
+        }
+        return now;
+    }
+
+    // Upper bound of the bucket holding the p-th call, in microseconds
+    double percentileUs(const ZoneCounters& z, double p) {
+        uint64_t target = static_cast<uint64_t>(p * z.calls);
+        uint64_t seen = 0;
+        for (int b = 0; b < PROFILE_BUCKETS; b++) {
+            seen += z.buckets[b];
+            if (seen > target) {
+                return static_cast<double>(uint64_t(1) << b) / 1000.0;
+            }
+        }
+        return static_cast<double>(uint64_t(1) << (PROFILE_BUCKETS - 1)) / 1000.0;
+    }
+}
+
+void profileRecord(ProfileZone zone, uint64_t ns) {
+    ThreadProfile& profile = threadProfile();
+    int z = static_cast<int>(zone);
+    int bucket = std::min<int>(static_cast<int>(std::bit_width(ns)), PROFILE_BUCKETS - 1);
+    bump(profile.calls[z], 1);
+    bump(profile.total_ns[z], ns);
+    bump(profile.buckets[z][bucket], 1);
+}
+
+void resetProfile() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (int z = 0; z < ZONE_COUNT; z++) {
+        retired().baseline[z] = current(retired(), z);
+        retired_threads[z] = 0;
+        for (auto& profile : registry()) {
+            profile->baseline[z] = current(*profile, z);
+        }
+    }
+}
+
+void printProfile(bool reset) {
+    if (!profiling_enabled) {
+        std::cout << "Profiling was compiled out (EMU_ENABLE_PROFILING=0)." << std::endl;
+        return;
+    }
+
+    ZoneCounters totals[ZONE_COUNT];
+    int threads[ZONE_COUNT] = {};
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        std::vector<ThreadProfile*> profiles = { &retired() };
+        for (auto& profile : registry()) {
+            profiles.push_back(profile.get());
+        }
+        for (int z = 0; z < ZONE_COUNT; z++) {
+            threads[z] = retired_threads[z];
+            if (reset) {
+                retired_threads[z] = 0;
+            }
+        }
+        for (ThreadProfile* profile : profiles) {
+            for (int z = 0; z < ZONE_COUNT; z++) {
+                ZoneCounters now = current(*profile, z);
+
+                ZoneCounters& base = profile->baseline[z];
+                if (profile != &retired() && now.calls > base.calls) {
+                    threads[z]++;
+                }
+                totals[z].calls += now.calls - base.calls;
+                totals[z].total_ns += now.total_ns - base.total_ns;
+                for (int b = 0; b < PROFILE_BUCKETS; b++) {
+                    totals[z].buckets[b] += now.buckets[b] - base.buckets[b];
+                }
+                if (reset) {
+                    base = now;
+                }
+            }
+        }
+    }
+
+    std::ios_base::fmtflags flags = std::cout.flags();
+    std::streamsize precision = std::cout.precision();
+    std::cout << "--------------------------------------" << std::endl;
+    std::cout << std::left << std::setw(13) << "Zone" << std::right
+        << std::setw(12) << "Calls" << std::setw(12) << "Total ms"
+        << std::setw(10) << "Avg us" << std::setw(10) << "p50 us"
+        << std::setw(10) << "p99 us" << std::setw(9) << "Threads" << std::endl;
+    std::cout << std::fixed;
+    for (int z = 0; z < ZONE_COUNT; z++) {
+        const ZoneCounters& t = totals[z];
+        std::cout << std::left << std::setw(13) << zoneName(z) << std::right
+            << std::setw(12) << t.calls
+            << std::setw(12) << std::setprecision(1) << t.total_ns / 1e6
+            << std::setw(10) << std::setprecision(2) << (t.calls ? t.total_ns / 1000.0 / t.calls : 0.0)
+            << std::setw(10) << (t.calls ? percentileUs(t, 0.50) : 0.0)
+            << std::setw(10) << (t.calls ? percentileUs(t, 0.99) : 0.0)
+            << std::setw(9) << threads[z] << std::endl;
+    }
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+    std::cout << "--------------------------------------" << std::endl;
+    if (reset) {
+        std::cout << "Profile counters reset." << std::endl;
+    }
+    if (!profiling_active) {
+        std::cout << "Profiling is off; run 'profile-start' to collect timings." << std::endl;
+    }
+}
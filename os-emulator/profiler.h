@@ -0,0 +1,70 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Build with EMU_ENABLE_PROFILING=0 to compile every ProfileScope down to nothing
+#ifndef EMU_ENABLE_PROFILING
+#define EMU_ENABLE_PROFILING 1
+#endif
+
+constexpr bool profiling_enabled = EMU_ENABLE_PROFILING != 0;
+
+// Runtime switch, off by default: while off, a ProfileScope costs one
+// relaxed load and takes no timestamps
+extern std::atomic<bool> profiling_active;
+
+enum class ProfileZone : uint8_t {
+    Execute,        // Process::executeNextInstruction
+    LogPrint,       // Process::logPrint
+    Dispatch,       // Scheduler::schedule core assignment
+    Preempt,        // RR preemption
+    AddProcess,     // Scheduler::addProcess
+    PrintStatus,    // Scheduler::printStatus
+    Count
+};
+
+constexpr int PROFILE_BUCKETS = 32;     // log2(ns) histogram buckets
+
+// Adds one timed call to the calling thread's statistics for the zone
+void profileRecord(ProfileZone zone, uint64_t ns);
+
+// Prints calls, time and latency percentiles per zone, summed over all
+// threads since the previous reset
+void printProfile(bool reset = true);
+void resetProfile();
+
+template <bool Enabled>
+class BasicProfileScope {
+public:
+    explicit BasicProfileScope(ProfileZone) {}
+};
+
+template <>
+class BasicProfileScope<true> {
+public:
+    explicit BasicProfileScope(ProfileZone zone)
+        : zone(zone), timed(profiling_active.load(std::memory_order_relaxed)) {
+        if (timed) {
+            begin = std::chrono::steady_clock::now();
+        }
+    }
+    ~BasicProfileScope() {
+        if (!timed) return;
+        auto elapsed = std::chrono::steady_clock::now() - begin;
+        profileRecord(zone, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+    BasicProfileScope(const BasicProfileScope&) = delete;
+    BasicProfileScope& operator=(const BasicProfileScope&) = delete;
+
+private:
+    ProfileZone zone;
+    bool timed;
+    std::chrono::steady_clock::time_point begin;
+};
+
+using ProfileScope = BasicProfileScope<profiling_enabled>;
+
+#endif // PROFILER_H
@@ -0,0 +1,261 @@
+#include "program.h"
+#include <algorithm>
+
+int Program::findVariable(const std::string& name) const {
+    for (size_t i = 0; i < var_names.size(); i++) {
+        if (var_names[i] == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+size_t Program::heapBytes() const {
+    size_t bytes = sizeof(Program) + code.capacity() * sizeof(Op)
+        + (constants.capacity() + var_names.capacity()) * sizeof(std::string);
+    for (const auto& constant : constants) {
+        bytes += stringHeapBytes(constant);
+    }
+    for (const auto& var : var_names) {
+        bytes += stringHeapBytes(var);
+    }
+    return bytes;
+}
+
+size_t stringHeapBytes(const std::string& s) {
+    static const size_t inline_capacity = std::string().capacity();
+    // capacity excludes the terminator the allocation also holds
+    return s.capacity() > inline_capacity ? s.capacity() + 1 : 0;
+}
+
+uint8_t ProgramBuilder::slot(const std::string& var) {
+    int index = program->findVariable(var);
+    if (index >= 0) return static_cast<uint8_t>(index);
+    // Slots are one byte; further names share the last slot
+    if (program->var_names.size() > 255) return 255;
+    program->var_names.push_back(var);
+    return static_cast<uint8_t>(program->var_names.size() - 1);
+}
+
+void ProgramBuilder::emit(const Op& op) {
+    ops.push_back(op);
+    program->source_lines++;
+    if (!open_loops.empty()) {
+        open_loops.back()++;
+    }
+}
+
+void ProgramBuilder::print(const std::string& message) {
+    auto it = std::find(program->constants.begin(), program->constants.end(), message);
+    size_t index = it - program->constants.begin();
+    if (it == program->constants.end()) {
+        program->constants.push_back(message);
+    }
+    emit({ OpCode::Print, 0, 0, 0, 0, static_cast<uint16_t>(index) });
+}
+
+void ProgramBuilder::declare(const std::string& var, uint16_t value) {
+    emit({ OpCode::Declare, slot(var), 0, 0, value, 0 });
+}
+
+void ProgramBuilder::add(const std::string& dst, const Value& lhs, const Value& rhs) {
+    bool lhs_var = std::holds_alternative<std::string>(lhs);
+    bool rhs_var = std::holds_alternative<std::string>(rhs);
+    if (lhs_var && rhs_var) {
+        emit({ OpCode::AddVV, slot(dst), slot(std::get<std::string>(lhs)),
+            slot(std::get<std::string>(rhs)), 0, 0 });
+    }
+    else if (lhs_var || rhs_var) {
+        const std::string& var = std::get<std::string>(lhs_var ? lhs : rhs);
+        uint16_t imm = std::get<uint16_t>(lhs_var ? rhs : lhs);
+        emit({ OpCode::Add, slot(dst), slot(var), 0, imm, 0 });
+    }
+    else {
+        emit({ OpCode::Declare, slot(dst), 0, 0,
+            addWrap(std::get<uint16_t>(lhs), std::get<uint16_t>(rhs)), 0 });
+    }
+}
+
+void ProgramBuilder::subtract(const std::string& dst, const Value& lhs, const Value& rhs) {
+    bool lhs_var = std::holds_alternative<std::string>(lhs);
+    bool rhs_var = std::holds_alternative<std::string>(rhs);
+    if (lhs_var && rhs_var) {
+        emit({ OpCode::SubtractVV, slot(dst), slot(std::get<std::string>(lhs)),
+            slot(std::get<std::string>(rhs)), 0, 0 });
+    }
+    else if (lhs_var) {
+        emit({ OpCode::Subtract, slot(dst), slot(std::get<std::string>(lhs)), 0,
+            std::get<uint16_t>(rhs), 0 });
+    }
+    else if (rhs_var) {
+        emit({ OpCode::SubtractIV, slot(dst), slot(std::get<std::string>(rhs)), 0,
+            std::get<uint16_t>(lhs), 0 });
+    }
+    else {
+        emit({ OpCode::Declare, slot(dst), 0, 0,
+            subtractSaturate(std::get<uint16_t>(lhs), std::get<uint16_t>(rhs)), 0 });
+    }
+}
+
+void ProgramBuilder::sleep(uint8_t ticks) {
+    emit({ OpCode::Sleep, 0, 0, 0, ticks, 0 });
+}
+
+void ProgramBuilder::io(bool write, uint8_t device, uint16_t kb) {
+    emit({ write ? OpCode::Write : OpCode::Read, 0, 0, device, kb, 0 });
+}
+
+bool ProgramBuilder::beginLoop(uint16_t count) {
+    if (depth() >= MAX_LOOP_DEPTH) return false;
+    // The FOR line is credited to the enclosing loop when this one ends
+    ops.push_back({ OpCode::LoopBegin, 0, 0, 0, count, 0 });
+    program->source_lines++;
+    open_loops.push_back(1);
+    return true;
+}
+
+bool ProgramBuilder::endLoop() {
+    if (open_loops.empty()) return false;
+    uint64_t lines = open_loops.back();
+    open_loops.pop_back();
+    if (!open_loops.empty()) {
+        open_loops.back() += lines;
+    }
+    ops.push_back({ OpCode::LoopEnd, 0, 0, 0,
+        static_cast<uint16_t>(std::min<uint64_t>(lines, UINT16_MAX)), 0 });
+    return true;
+}
+
+std::shared_ptr<Program> ProgramBuilder::build() {
+    while (!open_loops.empty()) {
+        endLoop();
+    }
+
+    std::vector<Op>& out = program->code;
+    out.clear();
+    out.reserve(ops.size());
+    int depth = 0;
+
+    for (const Op& op : ops) {
+        if (op.code == OpCode::LoopBegin) {
+            depth++;
+        }
+        else if (op.code == OpCode::LoopEnd) {
+            depth--;
+            size_t n = out.size();
+            // FOR over a single arithmetic op (possibly already fused)
+            if (fuse && n >= 2 && out[n - 2].code == OpCode::LoopBegin && out[n - 2].imm > 0) {
+                Op body = out[n - 1];
+                uint32_t count = out[n - 2].imm;
+                bool fused = true;
+                switch (body.code) {
+                case OpCode::Add: body.code = OpCode::ForAdd; body.arg = 1; break;
+                case OpCode::Subtract: body.code = OpCode::ForSubtract; body.arg = 1; break;
+                case OpCode::Declare: body.code = OpCode::ForDeclare; body.arg = 1; break;
+                case OpCode::ForAdd:
+                case OpCode::ForSubtract:
+                case OpCode::ForDeclare: break;
+                default: fused = false; break;
+                }
+                if (fused && count * body.arg <= UINT16_MAX) {
+                    body.arg = static_cast<uint16_t>(count * body.arg);
+                    body.c = static_cast<uint8_t>(std::min<uint16_t>(op.imm, UINT8_MAX));
+                    out.pop_back();
+                    out.back() = body;
+                    continue;
+                }
+            }
+            out.push_back(op);
+            continue;
+        }
+        else if (fuse && depth > 0 && op.code == OpCode::Add
+            && !out.empty() && out.back().code == OpCode::Declare) {
+            // DECLARE x v; ADD y z k inside a loop body
+            Op& prev = out.back();
+            prev = { OpCode::DeclareAdd, prev.a, op.a, op.b, prev.imm, op.imm };
+            continue;
+        }
+        out.push_back(op);
+    }
+
+    // Resolve loop offsets now that fusion has settled the layout
+    std::vector<size_t> begins;
+    for (size_t i = 0; i < out.size(); i++) {
+        if (out[i].code == OpCode::LoopBegin) {
+            begins.push_back(i);
+        }
+        else if (out[i].code == OpCode::LoopEnd) {
+            size_t begin = begins.back();
+            begins.pop_back();
+            out[begin].arg = static_cast<uint16_t>(i - begin);
+            out[i].arg = static_cast<uint16_t>(i - begin - 1);
+        }
+    }
+    return program;
+}
+
+std::shared_ptr<Program> generateProgram(const std::string& name, int total_instructions,
+    InstructionMix mix, std::mt19937& gen, bool fuse)
+{
+    std::uniform_int_distribution<uint16_t> value_dist(0, 100);
+    std::uniform_int_distribution<uint16_t> value_dist_uint8(0, 100);
+    std::uniform_int_distribution<int> op_dist(0, 5);
+    std::uniform_int_distribution<int> body_dist(1, 3);
+    // Arithmetic mix: DECLARE/ADD/SUBTRACT plus single-statement FORs, no PRINT/SLEEP
+    static const int arithmetic_ops[] = { 1, 2, 3, 5 };
+    std::uniform_int_distribution<int> arith_dist(0, 3);
+    // Loop mix: as arithmetic, but every other statement opens a FOR
+    static const int loop_ops[] = { 1, 2, 3, 5, 5, 5 };
+    std::uniform_int_distribution<int> loop_dist(0, 5);
+    // I/O mix: arithmetic with a READ or WRITE as every fourth statement on average
+    static const int io_ops[] = { 1, 2, 3, 6 };
+    std::uniform_int_distribution<int> io_dist(0, 3);
+    std::uniform_int_distribution<int> device_dist(0, 3);
+    std::uniform_int_distribution<uint16_t> kb_dist(4, 256);
+
+    ProgramBuilder builder(fuse);
+    // Statements still owed to each open FOR body
+    std::vector<int> body_left;
+
+    for (int i = 0; i < total_instructions; i++) {
+        int op = mix == InstructionMix::Arithmetic ? arithmetic_ops[arith_dist(gen)]
+            : mix == InstructionMix::Loops ? loop_ops[loop_dist(gen)]
+            : mix == InstructionMix::IoBound ? io_ops[io_dist(gen)]
+            : op_dist(gen);
+        if (op == 5 && builder.depth() >= MAX_LOOP_DEPTH) {
+            op = 2;
+        }
+
+        std::string var = "var" + std::to_string(i % 10);
+        std::string next = "var" + std::to_string((i + 1) % 10);
+        switch (op) {
+        case 0: // PRINT
+            builder.print("Hello world from " + name + "!");
+            break;
+        case 1: // DECLARE
+            builder.declare(var, value_dist(gen));
+            break;
+        case 2: // ADD
+            builder.add(var, next, value_dist(gen));
+            break;
+        case 3: // SUBTRACT
+            builder.subtract(var, next, value_dist(gen));
+            break;
+        case 4: // SLEEP
+            builder.sleep(static_cast<uint8_t>(value_dist_uint8(gen) % 10 + 1));
+            break;
+        case 5: // FOR: the next 1-3 statements form the body
+            builder.beginLoop(3);
+            body_left.push_back(mix == InstructionMix::Arithmetic ? 1 : body_dist(gen));
+            continue;
+        case 6: // READ or WRITE
+            builder.io(gen() & 1, static_cast<uint8_t>(device_dist(gen)), kb_dist(gen));
+            break;
+        }
+
+        // A finished statement may complete one or more enclosing FOR bodies
+        while (!body_left.empty() && --body_left.back() == 0) {
+            body_left.pop_back();
+            builder.endLoop();
+        }
+    }
+    return builder.build();
+}
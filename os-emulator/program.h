@@ -0,0 +1,224 @@
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <variant>
+#include <random>
+#include <cstdint>
+
+using Value = std::variant<uint16_t, std::string>;
+
+enum class InstructionMix { Mixed, Arithmetic, Loops, IoBound };
+
+constexpr int MAX_LOOP_DEPTH = 3;
+
+enum class OpCode : uint8_t {
+    Nop,
+    Print,          // arg: constant index
+    Declare,        // a = imm
+    Add,            // a = b + imm
+    AddVV,          // a = b + c
+    Subtract,       // a = b - imm (saturates at 0)
+    SubtractVV,     // a = b - c
+    SubtractIV,     // a = imm - b
+    Sleep,          // imm: ticks
+    LoopBegin,      // imm: count, arg: distance to the matching LoopEnd
+    LoopEnd,        // imm: source lines covered by the loop, arg: distance back to the body
+    // Superinstructions produced by ProgramBuilder
+    ForAdd,         // FOR arg { ADD a b imm }, c: source lines
+    ForSubtract,    // FOR arg { SUBTRACT a b imm }, c: source lines
+    ForDeclare,     // FOR arg { DECLARE a imm }, c: source lines
+    DeclareAdd,     // DECLARE a imm; ADD b c arg
+    Read,           // c: device, imm: kilobytes
+    Write,          // c: device, imm: kilobytes
+};
+
+// Compiled instruction. Fixed size and trivially copyable so program code
+// can be shared between processes or stored as-is on disk.
+struct Op {
+    OpCode code;
+    uint8_t a;
+    uint8_t b;
+    uint8_t c;
+    uint16_t imm;
+    uint16_t arg;
+};
+static_assert(sizeof(Op) == 8, "Op must stay 8 bytes");
+
+struct Program {
+    std::vector<Op> code;
+    std::vector<std::string> constants;     // PRINT messages
+    std::vector<std::string> var_names;     // variable slot -> name
+    uint64_t source_lines = 0;
+
+    // Set for programs loaded from an image file. Their code is a private
+    // copy, validated after copying, and is shared by every process started
+    // from that image.
+    std::string image_path;
+
+    const Op* ops() const { return code.data(); }
+    size_t opCount() const { return code.size(); }
+    int findVariable(const std::string& name) const;
+    // Heap bytes held by this Program, itself included
+    size_t heapBytes() const;
+};
+
+// Bytes a string holds beyond its own object (0 while it fits inline)
+size_t stringHeapBytes(const std::string& s);
+
+// Builds a Program from source-level instructions. FOR bodies may hold any
+// number of statements, nested up to MAX_LOOP_DEPTH. With fusion enabled,
+// loops over a single arithmetic op and DECLARE+ADD pairs inside loop
+// bodies become superinstructions.
+class ProgramBuilder {
+public:
+    explicit ProgramBuilder(bool fuse = true) : fuse(fuse) {}
+
+    void print(const std::string& message);
+    void declare(const std::string& var, uint16_t value);
+    void add(const std::string& dst, const Value& lhs, const Value& rhs);
+    void subtract(const std::string& dst, const Value& lhs, const Value& rhs);
+    void sleep(uint8_t ticks);
+    void io(bool write, uint8_t device, uint16_t kb);
+    bool beginLoop(uint16_t count);
+    bool endLoop();
+    int depth() const { return static_cast<int>(open_loops.size()); }
+
+    std::shared_ptr<Program> build();
+
+private:
+    bool fuse;
+    std::shared_ptr<Program> program = std::make_shared<Program>();
+    std::vector<Op> ops;
+    std::vector<uint64_t> open_loops;       // source lines seen in each open loop
+
+    uint8_t slot(const std::string& var);
+    void emit(const Op& op);
+};
+
+std::shared_ptr<Program> generateProgram(const std::string& name, int total_instructions,
+    InstructionMix mix, std::mt19937& gen, bool fuse = true);
+
+inline uint16_t addWrap(uint16_t lhs, uint16_t rhs) {
+    return static_cast<uint16_t>(lhs + rhs);
+}
+
+inline uint16_t subtractSaturate(uint16_t lhs, uint64_t rhs) {
+    return rhs >= lhs ? 0 : static_cast<uint16_t>(lhs - rhs);
+}
+
+// Source lines a top-level statement accounts for
+inline uint64_t statementLines(const Op* code, size_t pc) {
+    switch (code[pc].code) {
+    case OpCode::LoopBegin: return code[pc + code[pc].arg].imm;
+    case OpCode::ForAdd:
+    case OpCode::ForSubtract:
+    case OpCode::ForDeclare: return code[pc].c;
+    default: return 1;
+    }
+}
+
+// Env provides uint16_t& var(uint8_t slot), print(uint16_t constant),
+// sleep(uint8_t ticks) and io(bool write, uint8_t device, uint16_t kb), so
+// the same semantics serve every interpreter.
+template <class Env>
+inline void executeOp(const Op& op, Env& env) {
+    switch (op.code) {
+    case OpCode::Print:
+        env.print(op.arg);
+        break;
+    case OpCode::Declare:
+    case OpCode::ForDeclare:
+        env.var(op.a) = op.imm;
+        break;
+    case OpCode::Add:
+        env.var(op.a) = addWrap(env.var(op.b), op.imm);
+        break;
+    case OpCode::AddVV:
+        env.var(op.a) = addWrap(env.var(op.b), env.var(op.c));
+        break;
+    case OpCode::Subtract:
+        env.var(op.a) = subtractSaturate(env.var(op.b), op.imm);
+        break;
+    case OpCode::SubtractVV:
+        env.var(op.a) = subtractSaturate(env.var(op.b), env.var(op.c));
+        break;
+    case OpCode::SubtractIV:
+        env.var(op.a) = subtractSaturate(op.imm, env.var(op.b));
+        break;
+    case OpCode::Sleep:
+        env.sleep(static_cast<uint8_t>(op.imm));
+        break;
+    case OpCode::Read:
+    case OpCode::Write:
+        env.io(op.code == OpCode::Write, op.c, op.imm);
+        break;
+    case OpCode::ForAdd:
+        // Repeating "a = b + k" only accumulates when a and b are the same slot
+        if (op.a == op.b) {
+            env.var(op.a) = static_cast<uint16_t>(env.var(op.a) + uint64_t(op.arg) * op.imm);
+        }
+        else {
+            env.var(op.a) = addWrap(env.var(op.b), op.imm);
+        }
+        break;
+    case OpCode::ForSubtract:
+        if (op.a == op.b) {
+            env.var(op.a) = subtractSaturate(env.var(op.a), uint64_t(op.arg) * op.imm);
+        }
+        else {
+            env.var(op.a) = subtractSaturate(env.var(op.b), op.imm);
+        }
+        break;
+    case OpCode::DeclareAdd:
+        env.var(op.a) = op.imm;
+        env.var(op.b) = addWrap(env.var(op.c), op.arg);
+        break;
+    default:
+        break;
+    }
+}
+
+// Runs the statement at pc (one op or a whole loop nest) and returns the
+// index of the next statement. Loop bodies are jumped over, never re-decoded.
+template <class Env>
+inline size_t executeStatement(const Op* code, size_t pc, Env& env) {
+    if (code[pc].code != OpCode::LoopBegin) {
+        executeOp(code[pc], env);
+        return pc + 1;
+    }
+
+    struct Frame { size_t body; uint16_t left; } stack[MAX_LOOP_DEPTH];
+    int depth = 0;
+    size_t ip = pc;
+    do {
+        const Op& op = code[ip];
+        if (op.code == OpCode::LoopBegin) {
+            if (op.imm == 0) {
+                ip += op.arg + 1;
+                continue;
+            }
+            stack[depth++] = { ip + 1, op.imm };
+            ip++;
+        }
+        else if (op.code == OpCode::LoopEnd) {
+            Frame& frame = stack[depth - 1];
+            if (--frame.left > 0) {
+                ip = frame.body;
+            }
+            else {
+                depth--;
+                ip++;
+            }
+        }
+        else {
+            executeOp(op, env);
+            ip++;
+        }
+    } while (depth > 0);
+    return ip;
+}
+
+#endif // PROGRAM_H
@@ -0,0 +1,221 @@
+#include "quantum.h"
+#include "scheduler.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+namespace {
+    constexpr size_t KEPT_DECISIONS = 10;
+
+    const char* className(int c) {
+        static const char* names[] = { "interactive", "cpu" };
+        return names[c];
+    }
+
+    QuantumClassCounters difference(const QuantumClassCounters& now, const QuantumClassCounters& before) {
+        QuantumClassCounters delta;
+        delta.dispatches = now.dispatches - before.dispatches;
+        delta.wait_ns = now.wait_ns - before.wait_ns;
+        delta.preemptions = now.preemptions - before.preemptions;
+        delta.switch_ns = now.switch_ns - before.switch_ns;
+        return delta;
+    }
+
+    void add(QuantumClassCounters& total, const QuantumClassCounters& part) {
+        total.dispatches += part.dispatches;
+        total.wait_ns += part.wait_ns;
+        total.preemptions += part.preemptions;
+        total.switch_ns += part.switch_ns;
+    }
+}
+
+void QuantumController::start(Scheduler* s, const QuantumConfig& cfg) {
+    if (running || (cfg.mode != "global" && cfg.mode != "class")) return;
+    scheduler = s;
+    config = cfg;
+    config.min_quantum = std::max<uint64_t>(config.min_quantum, 1);
+    config.max_quantum = std::max(config.max_quantum, config.min_quantum);
+    config.interval_ms = std::max<uint64_t>(config.interval_ms, 10);
+    if (!config.log_file.empty()) {
+        log.open(config.log_file, std::ios::app);
+        if (!log.is_open()) {
+            std::cerr << "Error: Could not open quantum log: " << config.log_file << std::endl;
+        }
+        else if (log.tellp() == 0) {
+            log << "time_ms,scope,before,after,overhead,wait_ms,queue_depth,instructions_per_sec,reason\n";
+        }
+    }
+    stop_requested = false;
+    running = true;
+    thread = std::thread(&QuantumController::run, this);
+}
+
+void QuantumController::stop() {
+    if (!running) return;
+    stop_requested = true;
+    if (thread.joinable()) {
+        thread.join();
+    }
+    log.close();
+    running = false;
+}
+
+void QuantumController::run() {
+    QuantumSample previous = scheduler->sampleQuantum();
+    auto previous_time = std::chrono::steady_clock::now();
+
+    while (!stop_requested) {
+        auto wake = previous_time + std::chrono::milliseconds(config.interval_ms);
+        while (!stop_requested && std::chrono::steady_clock::now() < wake) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (stop_requested) break;
+
+        QuantumSample sample = scheduler->sampleQuantum();
+        auto now = std::chrono::steady_clock::now();
+        double interval_ns = static_cast<double>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now - previous_time).count());
+        QuantumClassCounters delta[QUANTUM_CLASSES];
+        for (int c = 0; c < QUANTUM_CLASSES; c++) {
+            delta[c] = difference(sample.classes[c], previous.classes[c]);
+        }
+
+        QuantumDecision decision;
+        decision.timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        decision.queue_depth = sample.queue_depth;
+        decision.instructions_per_sec = (sample.instructions - previous.instructions) / (interval_ns / 1e9);
+
+        if (config.mode == "global") {
+            QuantumClassCounters all;
+            for (const auto& part : delta) {
+                add(all, part);
+            }
+            uint64_t quantum = scheduler->getClassQuantum(QuantumClass::Cpu);
+            decision.scope = "all";
+            uint64_t next = decide(decision, quantum, all, interval_ns, sample.num_cores);
+            for (int c = 0; c < QUANTUM_CLASSES; c++) {
+                scheduler->setClassQuantum(static_cast<QuantumClass>(c), next);
+            }
+            record(decision);
+        }
+        else {
+            for (int c = 0; c < QUANTUM_CLASSES; c++) {
+                QuantumClass cls = static_cast<QuantumClass>(c);
+                QuantumDecision per_class = decision;
+                per_class.scope = className(c);
+                uint64_t next = decide(per_class, scheduler->getClassQuantum(cls), delta[c],
+                    interval_ns, sample.num_cores);
+                scheduler->setClassQuantum(cls, next);
+                record(per_class);
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(decisions_mutex);
+            intervals++;
+        }
+        previous = sample;
+        previous_time = now;
+    }
+}
+
+uint64_t QuantumController::decide(QuantumDecision& decision, uint64_t quantum,
+    const QuantumClassCounters& delta, double interval_ns, int cores)
+{
+    decision.before = quantum;
+    decision.after = quantum;
+    decision.overhead = cores > 0 ? delta.switch_ns / (interval_ns * cores) : 0.0;
+    decision.wait_ms = delta.dispatches > 0 ? delta.wait_ns / 1e6 / delta.dispatches : 0.0;
+
+    uint64_t next = quantum;
+    if (delta.dispatches == 0) {
+        decision.reason = "idle";
+    }
+    else if (decision.wait_ms > config.target_wait_ms && decision.overhead <= config.max_overhead) {
+        next = quantum - quantum / 4;
+        decision.reason = "wait above target";
+    }
+    else if (decision.overhead > config.max_overhead) {
+        next = quantum + std::max<uint64_t>(quantum / 4, 1);
+        decision.reason = "switch overhead above max";
+    }
+    else if (decision.wait_ms < config.target_wait_ms / 2 && decision.overhead > config.max_overhead / 2) {
+        next = quantum + std::max<uint64_t>(quantum / 8, 1);
+        decision.reason = "wait has headroom";
+    }
+    else {
+        decision.reason = "hold";
+    }
+    next = std::clamp(next, config.min_quantum, config.max_quantum);
+    if (next == quantum && decision.reason != "hold" && decision.reason != "idle") {
+        decision.reason += " (at bound)";
+    }
+    decision.after = next;
+    return next;
+}
+
+// Every interval goes to the log file; the console keeps recent changes
+void QuantumController::record(const QuantumDecision& d) {
+    if (log.is_open()) {
+        log << d.timestamp_ms << "," << d.scope << "," << d.before << "," << d.after << ","
+            << d.overhead << "," << d.wait_ms << "," << d.queue_depth << ","
+            << static_cast<uint64_t>(d.instructions_per_sec) << "," << d.reason << "\n";
+        log.flush();
+    }
+    if (d.before == d.after) return;
+    std::lock_guard<std::mutex> lock(decisions_mutex);
+    decision_count++;
+    decisions.push_back(d);
+    if (decisions.size() > KEPT_DECISIONS) {
+        decisions.pop_front();
+    }
+}
+
+void QuantumController::printStats(Scheduler* owner) {
+    QuantumSample sample = owner->sampleQuantum();
+    std::ios_base::fmtflags flags = std::cout.flags();
+    std::streamsize precision = std::cout.precision();
+
+    std::cout << "--------------------------------------" << std::endl;
+    std::cout << "Quantum mode: " << (running ? config.mode : std::string("fixed"));
+    if (running) {
+        std::cout << std::fixed << std::setprecision(1)
+            << "     Bounds: " << config.min_quantum << " - " << config.max_quantum
+            << "     Target wait: " << config.target_wait_ms << " ms"
+            << "     Max overhead: " << config.max_overhead * 100.0 << "%";
+    }
+    std::cout << std::endl;
+
+    std::cout << std::left << std::setw(13) << "Class" << std::right << std::setw(9) << "Quantum"
+        << std::setw(12) << "Dispatches" << std::setw(12) << "Preempts"
+        << std::setw(12) << "Avg wait" << std::setw(14) << "Avg switch" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    for (int c = 0; c < QUANTUM_CLASSES; c++) {
+        const QuantumClassCounters& k = sample.classes[c];
+        std::cout << std::left << std::setw(13) << className(c) << std::right
+            << std::setw(9) << owner->getClassQuantum(static_cast<QuantumClass>(c))
+            << std::setw(12) << k.dispatches << std::setw(12) << k.preemptions
+            << std::setw(9) << (k.dispatches ? k.wait_ns / 1e6 / k.dispatches : 0.0) << " ms"
+            << std::setw(11) << (k.preemptions ? k.switch_ns / 1e6 / k.preemptions : 0.0) << " ms"
+            << std::endl;
+    }
+
+    if (running) {
+        std::lock_guard<std::mutex> lock(decisions_mutex);
+        std::cout << "\nChanges: " << decision_count << " over " << intervals << " intervals"
+            << (config.log_file.empty() ? "" : " (every interval in " + config.log_file + ")") << std::endl;
+        std::cout << std::setprecision(2);
+        for (const QuantumDecision& d : decisions) {
+            std::cout << std::left << std::setw(13) << d.scope << std::right
+                << std::setw(5) << d.before << " -> " << std::setw(4) << d.after
+                << "   overhead " << std::setw(6) << d.overhead * 100.0 << "%"
+                << "   wait " << std::setw(8) << d.wait_ms << " ms"
+                << "   queue " << std::setw(5) << d.queue_depth
+                << "   " << d.reason << std::endl;
+        }
+    }
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+    std::cout << "--------------------------------------" << std::endl;
+}
@@ -0,0 +1,97 @@
+#ifndef QUANTUM_H
+#define QUANTUM_H
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <fstream>
+#include <cstdint>
+
+class Scheduler;
+
+// Processes are classed by how they last left a core: Interactive after
+// blocking on I/O (and on arrival), Cpu after using up a whole quantum
+enum class QuantumClass : uint8_t { Interactive, Cpu, Count };
+constexpr int QUANTUM_CLASSES = static_cast<int>(QuantumClass::Count);
+
+struct QuantumConfig {
+    std::string mode = "fixed";         // "fixed", "global" or "class"
+    uint64_t min_quantum = 1;
+    uint64_t max_quantum = 100;
+    double target_wait_ms = 50.0;       // ready-queue wait the controller aims below
+    double max_overhead = 0.05;         // share of core time allowed to go to switching
+    uint64_t interval_ms = 500;
+    std::string log_file;               // CSV of every decision; empty: memory only
+};
+
+// Counters the scheduler keeps per class, cumulative since start
+struct QuantumClassCounters {
+    uint64_t dispatches = 0;
+    uint64_t wait_ns = 0;               // ready queue to core, summed over dispatches
+    uint64_t preemptions = 0;
+    uint64_t switch_ns = 0;             // core idle from a preemption to its next dispatch
+};
+
+struct QuantumSample {
+    QuantumClassCounters classes[QUANTUM_CLASSES];
+    uint64_t instructions = 0;
+    int queue_depth = 0;
+    int num_cores = 0;
+};
+
+struct QuantumDecision {
+    int64_t timestamp_ms = 0;
+    std::string scope;                  // "all", "interactive" or "cpu"
+    uint64_t before = 0;
+    uint64_t after = 0;
+    double overhead = 0.0;
+    double wait_ms = 0.0;
+    int queue_depth = 0;
+    double instructions_per_sec = 0.0;
+    std::string reason;
+};
+
+// Adjusts the round-robin quantum between min and max every interval. Over
+// the interval it compares switching overhead (core time lost between a
+// preemption and the next dispatch) with the average ready-queue wait:
+//
+//   wait above target, overhead below max      shrink by a quarter
+//   overhead above max                         grow by a quarter
+//   wait under half the target, overhead
+//     above half the max                       grow by an eighth
+//
+// In "class" mode each class is judged on its own counters and gets its
+// own quantum. Every change is logged with the figures that caused it.
+class QuantumController {
+public:
+    ~QuantumController() { stop(); }
+
+    void start(Scheduler* scheduler, const QuantumConfig& config);
+    void stop();
+    bool isRunning() const { return running; }
+
+    // Takes the scheduler since fixed mode never starts the controller
+    void printStats(Scheduler* scheduler);
+
+private:
+    Scheduler* scheduler = nullptr;
+    QuantumConfig config;
+    std::thread thread;
+    std::atomic<bool> running{ false };
+    std::atomic<bool> stop_requested{ false };
+    std::ofstream log;
+
+    std::mutex decisions_mutex;
+    std::deque<QuantumDecision> decisions;  // most recent, for quantum-stat
+    uint64_t decision_count = 0;
+    uint64_t intervals = 0;                 // under decisions_mutex, like the decisions
+
+    void run();
+    uint64_t decide(QuantumDecision& decision, uint64_t quantum, const QuantumClassCounters& delta,
+        double interval_ns, int cores);
+    void record(const QuantumDecision& decision);
+};
+
+#endif // QUANTUM_H
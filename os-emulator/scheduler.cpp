@@ -1,13 +1,21 @@
 #include "scheduler.h"
+#include "trace.h"
+#include "profiler.h"
+#include "cycle_clock.h"
 #include <iostream>
 #include <chrono>
 #include <iomanip>
 #include <fstream>
 #include <random>
+#include <set>
+#include <algorithm>
 
 Scheduler::Scheduler(int num_cores)
     : num_cores(num_cores), cores(num_cores, nullptr),
-    stop_requested(false), is_running(false) {}
+    stop_requested(false), is_running(false)
+{
+    setQuantumCycles(quantum_cycles);
+}
 
 Scheduler::~Scheduler() {
     stop();
@@ -22,16 +30,72 @@ void Scheduler::start() {
     if (is_running) return;
     stop_requested = false;
     is_running = true;
-    quantum_counters.resize(num_cores, 0);
+    selectCoreLoops();
+    affinity_plan = planAffinity(affinity_config, num_cores);
+    bool pool = execution_mode == "pool";
+    int threads = pool_threads > 0 ? pool_threads
+        : static_cast<int>(std::thread::hardware_concurrency());
+    threads = std::max(threads, 1);
+
+    // Pool threads move between cores, so only dedicated workers own theirs
+    core_state.assign(num_cores, nullptr);
+    if (pool || !affinity_plan.numa_local) {
+        for (auto& state : core_state) {
+            state = createCoreState();
+        }
+    }
+
+    // Every core thread and the dispatcher check in once pinned
+    threads_ready = std::make_unique<std::latch>((pool ? threads : num_cores) + 1);
     scheduler_thread = std::thread(&Scheduler::schedule, this);
-    for (int i = 0; i < num_cores; i++) {
-        workers.push_back(std::thread(&Scheduler::worker, this, i));
+    if (pool) {
+        core_pool.start(num_cores, threads,
+            [this](int core_id) { return (this->*step_function)(core_id); },
+            [this](int core_id) {
+                std::lock_guard<InstrumentedMutex> lock(cores_mutex);
+                return cores[core_id] != nullptr;
+            },
+            [this](int thread_id) {
+                pinCurrentThread("pool " + std::to_string(thread_id), affinity_plan.pool(thread_id));
+                threads_ready->count_down();
+            });
+    }
+    else {
+        for (int i = 0; i < num_cores; i++) {
+            workers.push_back(std::thread(&Scheduler::runCore, this, i));
+        }
+    }
+    threads_ready->wait();
+    metrics_sampler.start(this, metrics_config);
+    stats_publisher.start(this, stats_config);
+    control_server.start(this, control_config);
+    if (policy == SchedulingPolicy::RR) {
+        quantum_controller.start(this, quantum_config);
+    }
+    if (!archive_config.file.empty() && !archive.isOpen()) {
+        std::string error;
+        if (archive.open(archive_config, error)) {
+            stop_archive = false;
+            archive_thread = std::thread(&Scheduler::archiveWorker, this);
+        }
+        else {
+            std::cout << "Finished processes will stay in memory: " << error << std::endl;
+        }
     }
 }
 
 void Scheduler::stop() {
     if (!is_running) return;
+    control_server.stop();
+    quantum_controller.stop();
+    metrics_sampler.stop();
+    stats_publisher.stop();
+    stop_archive = true;
+    if (archive_thread.joinable()) {
+        archive_thread.join();
+    }
     stop_requested = true;
+    cycle_waiters.wakeAll();
     if (scheduler_thread.joinable()) {
         scheduler_thread.join();
     }
@@ -41,29 +105,108 @@ void Scheduler::stop() {
         }
     }
     workers.clear();
+    core_pool.stop();
+    for (CoreState*& state : core_state) {
+        state->~CoreState();
+        freeLocal(state, sizeof(CoreState));
+        state = nullptr;
+    }
     is_running = false;
 }
 
-void Scheduler::addProcess(Process* process) {
+bool Scheduler::addProcess(Process* process, std::string* reason) {
+    return insert(process, false, reason) == AddResult::Added;
+}
+
+AddResult Scheduler::tryAddProcess(Process* process) {
+    return insert(process, true, nullptr);
+}
+
+AddResult Scheduler::insert(Process* process, bool unique, std::string* reason) {
+    ProfileScope profile(ProfileZone::AddProcess);
+    if (!admission.tryAdmit(process, reason)) {
+        admission.recordRejected();
+        return AddResult::Rejected;
+    }
+    return registerAdmitted(process, unique);
+}
+
+AddResult Scheduler::submitProcess(Process* process, bool unique, const std::atomic<bool>* stop) {
+    if (!admission.throttles()) {
+        return insert(process, unique, nullptr);
+    }
+    ProfileScope profile(ProfileZone::AddProcess);
+    auto begin = std::chrono::steady_clock::now();
+    bool waited = false;
+    while (!admission.tryAdmit(process)) {
+        if (*stop) {
+            admission.recordRejected();
+            return AddResult::Rejected;
+        }
+        waited = true;
+        admission.waitForRoom(stop);
+    }
+    if (waited) {
+        auto elapsed = std::chrono::steady_clock::now() - begin;
+        admission.recordDeferred(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+    return registerAdmitted(process, unique);
+}
+
+void Scheduler::adoptProcess(Process* process) {
+    admission.charge(process);
+    registerAdmitted(process, false);
+}
+
+AddResult Scheduler::registerAdmitted(Process* process, bool unique) {
     {
-        std::lock_guard<std::mutex> lock(all_processes_mutex);
+        std::lock_guard<InstrumentedMutex> lock(all_processes_mutex);
+        if (unique && !all_processes.emplace(process->name, process).second) {
+            admission.cancel(process);
+            return AddResult::Exists;
+        }
+        // Archiving adds a name to the archive before dropping it from
+        // all_processes, so checking second never misses one in transit
+        if (unique && archive.isOpen() && archive.contains(process->name)) {
+            all_processes.erase(process->name);
+            admission.cancel(process);
+            return AddResult::Exists;
+        }
         all_processes[process->name] = process;
     }
-    std::lock_guard<std::mutex> lock(queue_mutex);
+    enqueue(process);
+    return AddResult::Added;
+}
+
+void Scheduler::enqueue(Process* process) {
+    traceEvent(TraceEventType::Arrive, -1, process->pid);
+    std::lock_guard<InstrumentedMutex> lock(queue_mutex);
+    process->queued_at = std::chrono::steady_clock::now();
     process_queue.push(process);
 }
 
-Process* Scheduler::getProcess(const std::string& name) {
-    std::lock_guard<std::mutex> lock(all_processes_mutex);
+bool Scheduler::withProcess(const std::string& name, const std::function<void(Process&)>& fn) {
+    std::lock_guard<InstrumentedMutex> lock(all_processes_mutex);
     auto it = all_processes.find(name);
-    if (it != all_processes.end()) {
-        return it->second;
+    if (it == all_processes.end()) return false;
+    fn(*it->second);
+    return true;
+}
+
+bool Scheduler::hasProcess(const std::string& name) {
+    std::lock_guard<InstrumentedMutex> lock(all_processes_mutex);
+    return all_processes.count(name) > 0;
+}
+
+void Scheduler::forEachProcess(const std::function<bool(Process&)>& fn) {
+    std::lock_guard<InstrumentedMutex> lock(all_processes_mutex);
+    for (const auto& entry : all_processes) {
+        if (!fn(*entry.second)) return;
     }
-    return nullptr;
 }
 
 int Scheduler::getActiveCores() {
-    std::lock_guard<std::mutex> lock(cores_mutex);
+    std::lock_guard<InstrumentedMutex> lock(cores_mutex);
     int count = 0;
     for (int i = 0; i < num_cores; i++) {
         //if (cores[i] != nullptr) {
@@ -75,7 +218,7 @@ int Scheduler::getActiveCores() {
 }
 
 int Scheduler::getQueueSize() {
-    std::lock_guard<std::mutex> lock(queue_mutex);
+    std::lock_guard<InstrumentedMutex> lock(queue_mutex);
     return process_queue.size();
 }
 
@@ -86,35 +229,36 @@ std::string Scheduler::formatTimePoint(const std::chrono::system_clock::time_poi
 }
 
 void Scheduler::printStatus(bool toFile) {
-    std::ostream* out;
-    std::ofstream file_out;
-
+    ProfileScope profile(ProfileZone::PrintStatus);
     if (toFile) {
-        file_out.open("csopesy-log.txt");
-        out = &file_out;
+        std::ofstream file_out("csopesy-log.txt");
+        writeStatus(file_out);
     }
     else {
-        out = &std::cout;
+        writeStatus(std::cout);
     }
+}
 
+void Scheduler::writeStatus(std::ostream& out) {
     int active_cores = getActiveCores();
     float utilization = (static_cast<float>(active_cores) / num_cores) * 100.0f;
 
-    *out << "--------------------------------------" << std::endl;
-    *out << "CPU Utilization: " << std::fixed << std::setprecision(0) << utilization << "%" << std::endl;
-    *out << "Active Cores: " << getActiveCores() << std::endl;
-    *out << "Cores Available: " << (num_cores - getActiveCores()) << std::endl;
-    *out << "Processes in queue: " << getQueueSize() << std::endl;
-    *out << "--------------------------------------" << std::endl;
-    *out << "Running processes:" << std::endl;
+    out << "--------------------------------------" << std::endl;
+    out << "CPU Utilization: " << std::fixed << std::setprecision(0) << utilization << "%" << std::endl;
+    out << "Active Cores: " << getActiveCores() << std::endl;
+    out << "Cores Available: " << (num_cores - getActiveCores()) << std::endl;
+    out << "Processes in queue: " << getQueueSize() << std::endl;
+    out << "Blocked on I/O: " << io.getBlockedCount() << std::endl;
+    out << "--------------------------------------" << std::endl;
+    out << "Running processes:" << std::endl;
 
     {
-        std::lock_guard<std::mutex> lock(cores_mutex);
+        std::lock_guard<InstrumentedMutex> lock(cores_mutex);
         for (int i = 0; i < num_cores; i++) {
             if (cores[i]) {
                 Process* p = cores[i];
                 int done = p->total_instructions - p->remaining_instructions.load();
-                *out << p->name << "     ("
+                out << p->name << "     ("
                     << formatTimePoint(p->start_time)
                     << ")     Core: " << i << "     "
                     << done << " / " << p->total_instructions << std::endl;
@@ -122,34 +266,374 @@ void Scheduler::printStatus(bool toFile) {
         }
     }
 
-    *out << "\nFinished processes:" << std::endl;
-    std::lock_guard<std::mutex> lock(finished_mutex);
-    for (Process* p : finished_processes) {
-        *out << p->name << "     ("
-            << formatTimePoint(p->end_time)
-            << ")     Finished     "
-            << p->total_instructions << " / " << p->total_instructions << std::endl;
+    out << "\nFinished processes:" << std::endl;
+    {
+        std::lock_guard<InstrumentedMutex> lock(finished_mutex);
+        for (Process* p : finished_processes) {
+            out << p->name << "     ("
+                << formatTimePoint(p->end_time)
+                << ")     Finished     "
+                << p->total_instructions << " / " << p->total_instructions << std::endl;
+        }
+    }
+    if (archive.isOpen()) {
+        uint64_t archived = archive.getStats().processes;
+        if (archived > 0) {
+            out << "(" << archived << " older finished processes archived to " << archive.getPath() << ")" << std::endl;
+        }
+    }
+    out << "--------------------------------------" << std::endl;
+}
+
+std::vector<Process*> Scheduler::takeQueued(size_t max) {
+    std::vector<Process*> taken;
+    {
+        // The most recently queued processes are the furthest from a core
+        std::lock_guard<InstrumentedMutex> lock(queue_mutex);
+        std::vector<Process*> waiting;
+        while (!process_queue.empty()) {
+            waiting.push_back(process_queue.front());
+            process_queue.pop();
+        }
+        size_t keep = waiting.size() - std::min(max, waiting.size());
+        for (size_t i = 0; i < waiting.size(); i++) {
+            if (i < keep) {
+                process_queue.push(waiting[i]);
+            }
+            else {
+                taken.push_back(waiting[i]);
+            }
+        }
     }
-    *out << "--------------------------------------" << std::endl;
+    std::lock_guard<InstrumentedMutex> lock(all_processes_mutex);
+    for (Process* p : taken) {
+        all_processes.erase(p->name);
+        admission.release(p);
+    }
+    return taken;
+}
 
-    if (toFile) {
-        file_out.close();
+MetricsSample Scheduler::sampleMetrics() {
+    MetricsSample sample;
+    sample.cycle = cpu_cycles;
+    sample.timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    sample.num_cores = num_cores;
+    {
+        std::lock_guard<InstrumentedMutex> lock(cores_mutex);
+        for (int i = 0; i < num_cores; i++) {
+            if (cores[i] != nullptr) {
+                sample.running++;
+                if (cores[i]->state == ProcessState::Running) {
+                    sample.active_cores++;
+                }
+            }
+        }
+    }
+    sample.queue_depth = getQueueSize();
+    sample.finished = finished_count;
+    sample.instructions = instructions_executed;
+    sample.dispatches = dispatch_count;
+    sample.preemptions = preempt_count;
+    return sample;
+}
+
+// A process leaves its core before it can be archived or migrated, so
+// occupants are safe to read under cores_mutex alone
+std::vector<CoreOccupant> Scheduler::getCoreOccupants() {
+    std::vector<CoreOccupant> occupants(num_cores);
+    std::lock_guard<InstrumentedMutex> lock(cores_mutex);
+    for (int i = 0; i < num_cores; i++) {
+        if (Process* p = cores[i]) {
+            occupants[i].pid = p->pid;
+            occupants[i].name = p->name;
+            occupants[i].sleeping = p->isSleeping();
+        }
+    }
+    return occupants;
+}
+
+void Scheduler::printGeneratorStats() {
+    GeneratorStats stats = generator.getStats();
+    auto avg_us = [](uint64_t ns, uint64_t n) {
+        return n > 0 ? static_cast<double>(ns) / n / 1000.0 : 0.0;
+    };
+
+    std::ios_base::fmtflags flags = std::cout.flags();
+    std::streamsize precision = std::cout.precision();
+    if (!workload_file.empty()) {
+        WorkloadStats replay = workload.getStats();
+        double progress = replay.file_bytes > 0 ? 100.0 * replay.bytes_read / replay.file_bytes : 100.0;
+        std::cout << "--------------------------------------" << std::endl;
+        std::cout << "Workload file: " << workload_file
+            << (replay.finished ? "     (replay complete)" : "") << std::endl;
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << "Read: " << replay.bytes_read << " / " << replay.file_bytes
+            << " bytes (" << progress << "%)" << std::endl;
+        std::cout << "Replayed: " << replay.replayed << "     Late: " << replay.late
+            << "     Duplicate names: " << replay.duplicates
+            << "     Malformed lines: " << replay.malformed
+            << "     Shed: " << replay.rejected << std::endl;
+        std::cout << "--------------------------------------" << std::endl;
+        std::cout.flags(flags);
+        std::cout.precision(precision);
+        return;
+    }
+
+    std::cout << "--------------------------------------" << std::endl;
+    std::cout << "Arrival model: " << arrival_config.model
+        << "     Generator threads: " << arrival_config.generator_threads << std::endl;
+    std::cout << "Processes generated: " << stats.generated
+        << "     Ready buffer: " << stats.buffered << " / " << arrival_config.buffer_size << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Generation: " << avg_us(stats.generation_ns, stats.generated) << " us/process" << std::endl;
+    std::cout << "Dispatch:   " << avg_us(stats.dispatch_ns, stats.dispatched) << " us/process ("
+        << stats.dispatched << " dispatched)" << std::endl;
+    std::cout << "Buffer stalls: " << stats.stalls << " of " << stats.taken << " takes, "
+        << avg_us(stats.stall_ns, stats.stalls) << " us average wait" << std::endl;
+    std::cout << "Skipped periods: " << stats.skipped_periods << " (batch worker fell behind)" << std::endl;
+    std::cout << "--------------------------------------" << std::endl;
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+}
+
+void Scheduler::printAdmissionStats() {
+    const AdmissionConfig& config = admission.getConfig();
+    AdmissionStats stats = admission.getStats();
+    auto limit = [](uint64_t value) {
+        return value > 0 ? std::to_string(value) : std::string("unlimited");
+    };
+
+    std::cout << "--------------------------------------" << std::endl;
+    std::cout << "Admission policy: " << config.policy << std::endl;
+    std::cout << "Live processes: " << stats.resident_processes << " / " << limit(config.max_queue_depth)
+        << " (" << getQueueSize() << " in the ready queue)" << std::endl;
+    std::cout << "Resident bytes: " << stats.resident_bytes << " / " << limit(config.max_resident_bytes) << std::endl;
+    std::cout << "Admitted: " << stats.admitted << "     Deferred: " << stats.deferred
+        << "     Rejected: " << stats.rejected << std::endl;
+    if (stats.deferred > 0) {
+        std::ios_base::fmtflags flags = std::cout.flags();
+        std::streamsize precision = std::cout.precision();
+        std::cout << std::fixed << std::setprecision(2) << "Average deferral: "
+            << static_cast<double>(stats.wait_ns) / stats.deferred / 1e6 << " ms" << std::endl;
+        std::cout.flags(flags);
+        std::cout.precision(precision);
+    }
+    std::cout << "--------------------------------------" << std::endl;
+}
+
+// Moves processes that finished more than after_ms ago into the archive and
+// frees them. Readers only touch a process under all_processes_mutex (see
+// withProcess) or, while it is on a core, under cores_mutex; a finished
+// process is off its core, so once erased from the table it can go.
+void Scheduler::archiveWorker() {
+    constexpr auto interval = std::chrono::milliseconds(500);
+    while (!stop_archive) {
+        auto wake = std::chrono::steady_clock::now() + interval;
+        while (!stop_archive && std::chrono::steady_clock::now() < wake) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+
+        auto cutoff = std::chrono::system_clock::now() - std::chrono::milliseconds(archive_config.after_ms);
+        std::vector<Process*> expired;
+        {
+            // Finish order, so the oldest are at the front
+            std::lock_guard<InstrumentedMutex> lock(finished_mutex);
+            while (!finished_processes.empty() && finished_processes.front()->end_time <= cutoff) {
+                expired.push_back(finished_processes.front());
+                finished_processes.pop_front();
+            }
+        }
+        if (expired.empty()) continue;
+
+        for (Process* p : expired) {
+            archive.append(p);
+        }
+        {
+            std::lock_guard<InstrumentedMutex> lock(all_processes_mutex);
+            for (Process* p : expired) {
+                auto it = all_processes.find(p->name);
+                if (it != all_processes.end() && it->second == p) {
+                    all_processes.erase(it);
+                }
+            }
+        }
+        for (Process* p : expired) {
+            delete p;
+        }
+    }
+}
+
+void Scheduler::printIoStats() {
+    std::vector<IoDeviceStats> devices = io.getStats();
+
+    std::ios_base::fmtflags flags = std::cout.flags();
+    std::streamsize precision = std::cout.precision();
+    std::cout << "--------------------------------------" << std::endl;
+    std::cout << std::left << std::setw(10) << "Device" << std::right
+        << std::setw(9) << "Latency" << std::setw(10) << "KB/cycle"
+        << std::setw(10) << "Reads" << std::setw(10) << "Writes" << std::setw(12) << "KB"
+        << std::setw(10) << "Depth" << std::setw(12) << "Avg wait" << std::setw(10) << "Max wait"
+        << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    for (const IoDeviceStats& device : devices) {
+        double average = device.completed > 0
+            ? static_cast<double>(device.latency_sum) / device.completed : 0.0;
+        std::cout << std::left << std::setw(10) << device.config.name << std::right
+            << std::setw(9) << device.config.latency_cycles << std::setw(10) << device.config.kb_per_cycle
+            << std::setw(10) << device.reads << std::setw(10) << device.writes << std::setw(12) << device.kb
+            << std::setw(10) << (std::to_string(device.in_flight) + "/" + std::to_string(device.max_in_flight))
+            << std::setw(12) << average << std::setw(10) << device.latency_max << std::endl;
+    }
+    // Blocked processes waiting alongside busy cores is the overlap I/O buys
+    std::cout << "Blocked on I/O: " << io.getBlockedCount()
+        << "     Cores busy: " << getActiveCores() << " / " << num_cores << std::endl;
+    std::cout << "(latency and waits in cycles; depth is in flight now / peak)" << std::endl;
+    std::cout << "--------------------------------------" << std::endl;
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+}
+
+void Scheduler::printMemoryStats(size_t top) {
+    struct Usage {
+        ProcessState state;
+        ProcessMemory memory;
+    };
+    const char* state_names[] = { "Queued", "Running", "Finished", "Blocked" };
+    ProcessMemory by_state[4];
+    size_t state_counts[4] = {};
+    std::set<const Program*> programs;
+    std::map<std::string, size_t> images;        // image path -> code bytes
+    size_t program_bytes = 0;
+    size_t table_bytes = 0;
+    std::vector<std::pair<Process*, Usage>> usage;
+    std::vector<std::pair<std::string, Usage>> heaviest;
+
+    {
+        std::lock_guard<InstrumentedMutex> lock(all_processes_mutex);
+        usage.reserve(all_processes.size());
+        for (const auto& entry : all_processes) {
+            Process* p = entry.second;
+            Usage u{ p->state.load(), p->measureMemory() };
+            int s = static_cast<int>(u.state);
+            state_counts[s]++;
+            by_state[s].program += u.memory.program;
+            by_state[s].variables += u.memory.variables;
+            by_state[s].logs += u.memory.logs;
+            by_state[s].bookkeeping += u.memory.bookkeeping;
+
+            const Program* program = p->getProgram();
+            if (program && programs.insert(program).second) {
+                program_bytes += program->heapBytes();
+                if (!program->image_path.empty()) {
+                    images[program->image_path] += program->code.capacity() * sizeof(Op);
+                }
+            }
+            // Map nodes: key, value and about four pointers of links
+            table_bytes += sizeof(std::pair<const std::string, Process*>) + 4 * sizeof(void*)
+                + stringHeapBytes(entry.first);
+            usage.emplace_back(p, u);
+        }
+
+        size_t n = std::min(top, usage.size());
+        std::partial_sort(usage.begin(), usage.begin() + n, usage.end(),
+            [](const auto& a, const auto& b) { return a.second.memory.total() > b.second.memory.total(); });
+        for (size_t i = 0; i < n; i++) {
+            heaviest.emplace_back(usage[i].first->name, usage[i].second);
+        }
+    }
+    {
+        std::lock_guard<InstrumentedMutex> lock(finished_mutex);
+        // List nodes: two links and the pointer
+        table_bytes += finished_processes.size() * 3 * sizeof(void*);
     }
+    table_bytes += getQueueSize() * sizeof(Process*);
+
+    ProcessMemory all;
+    size_t process_count = 0;
+    for (int s = 0; s < 4; s++) {
+        all.program += by_state[s].program;
+        all.variables += by_state[s].variables;
+        all.logs += by_state[s].logs;
+        all.bookkeeping += by_state[s].bookkeeping;
+        process_count += state_counts[s];
+    }
+    size_t image_bytes = 0;
+    for (const auto& image : images) {
+        image_bytes += image.second;
+    }
+
+    auto row = [](const std::string& label, size_t count, const ProcessMemory& m) {
+        std::cout << std::left << std::setw(10) << label << std::right << std::setw(10) << count
+            << std::setw(12) << m.program << std::setw(12) << m.variables << std::setw(12) << m.logs
+            << std::setw(13) << m.bookkeeping << std::setw(14) << m.total() << std::endl;
+    };
+    std::cout << "--------------------------------------" << std::endl;
+    std::cout << std::left << std::setw(10) << "State" << std::right << std::setw(10) << "Processes"
+        << std::setw(12) << "Program" << std::setw(12) << "Variables" << std::setw(12) << "Logs"
+        << std::setw(13) << "Bookkeeping" << std::setw(14) << "Total" << std::endl;
+    for (int s : { 0, 1, 3, 2 }) {
+        row(state_names[s], state_counts[s], by_state[s]);
+    }
+    row("All", process_count, all);
+    std::cout << "(bytes; a program shared by n processes is split n ways)" << std::endl;
+    std::cout << "Distinct programs: " << programs.size() << ", " << program_bytes << " bytes" << std::endl;
+    std::cout << "Loaded images: " << images.size() << ", " << image_bytes
+        << " bytes of code (part of the program bytes)" << std::endl;
+    std::cout << "Scheduler tables: " << table_bytes << " bytes" << std::endl;
+    size_t archive_index = 0;
+    if (archive.isOpen()) {
+        ArchiveStats archived = archive.getStats();
+        archive_index = archived.index_bytes + archived.pending_bytes;
+        std::cout << "Archive: " << archived.processes << " processes, " << archived.blocks << " blocks, "
+            << archived.file_bytes << " bytes on disk from " << archived.raw_bytes << " ("
+            << archived.lookups << " lookups, " << archived.block_reads << " block reads)" << std::endl;
+        std::cout << "Archive index and unflushed records: " << archive_index << " bytes" << std::endl;
+    }
+    std::cout << "Total heap: " << all.total() + table_bytes + archive_index << " bytes" << std::endl;
+
+    if (!heaviest.empty()) {
+        std::cout << "\nHeaviest processes:" << std::endl;
+        for (const auto& [name, u] : heaviest) {
+            std::cout << std::left << std::setw(20) << name << std::setw(10) << state_names[static_cast<int>(u.state)]
+                << std::right << std::setw(12) << u.memory.program << std::setw(12) << u.memory.variables
+                << std::setw(12) << u.memory.logs << std::setw(13) << u.memory.bookkeeping
+                << std::setw(14) << u.memory.total() << std::endl;
+        }
+    }
+    std::cout << "--------------------------------------" << std::endl;
 }
 
-void Scheduler::startBatchProcess() {
-    if (batch_running) return;
+bool Scheduler::startBatchProcess() {
+    if (batch_running) return true;
     stop_batch = false;
+    if (!workload_file.empty()) {
+        // Each start replays the trace from its beginning
+        if (!workload.open(workload_file)) {
+            std::cout << "Could not open workload file " << workload_file << std::endl;
+            return false;
+        }
+        batch_running = true;
+        batch_thread = std::thread(&WorkloadReplay::run, &workload, std::ref(*this), &stop_batch);
+        return true;
+    }
     batch_running = true;
+    generator.start(arrival_config, min_instructions, max_instructions, &process_counter);
     batch_thread = std::thread(&Scheduler::batchWorker, this);
+    return true;
 }
 
 void Scheduler::stopBatchProcess() {
     if (!batch_running) return;
     stop_batch = true;
+    cycle_waiters.wakeAll();
+    admission.notifyRoom();
     if (batch_thread.joinable()) {
         batch_thread.join();
     }
+    if (workload_file.empty()) {
+        generator.stop();
+    }
     batch_running = false;
 }
 
@@ -157,22 +641,41 @@ void Scheduler::stopBatchProcess() {
 void Scheduler::batchWorker() {
     std::random_device rd;
     std::mt19937 gen(rd());
-    std::uniform_int_distribution<uint64_t> dist(min_instructions, max_instructions);
+    ArrivalModel model(arrival_config);
+    uint64_t frequency = std::max<uint64_t>(batch_frequency, 1);
+    uint64_t period = 0;
+    uint64_t target_cycle = cpu_cycles;
 
     while (!stop_batch) {
-        // Generate a new process
-        std::string name = "p" + std::to_string(process_counter++);
-        uint64_t instructions = dist(gen);
-        Process* p = new Process(name, instructions);
-        addProcess(p);
+        // Release this period's arrivals; the programs are normally pre-built
+        uint64_t count = model.arrivals(period++, gen);
+        for (uint64_t i = 0; i < count && !stop_batch; i++) {
+            Process* p = generator.take();
+            if (!p) break;
+            auto begin = std::chrono::steady_clock::now();
+            if (submitProcess(p, false, &stop_batch) != AddResult::Added) {
+                delete p;
+            }
+            auto elapsed = std::chrono::steady_clock::now() - begin;
+            generator.recordDispatch(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
 
-        // Sleep for batch frequency (simulated)
-        /*for (uint64_t i = 0; i < batch_frequency && !stop_batch; i++) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        }*/
-        uint64_t target_cycle = cpu_cycles + batch_frequency;
+        // Wait for the next period boundary (simulated). The target is absolute
+        // so time spent generating does not push later arrivals back. After a
+        // stall (a console pause, admission throttling) the periods missed are
+        // skipped, not released back to back: this one is due now, the rest
+        // are dropped.
+        target_cycle += frequency;
+        uint64_t now_cycle = cpu_cycles;
+        if (target_cycle < now_cycle) {
+            uint64_t behind = (now_cycle - target_cycle) / frequency;
+            target_cycle += behind * frequency;
+            period += behind;
+            generator.recordSkipped(behind);
+        }
         while (cpu_cycles < target_cycle && !stop_batch) {
-            std::this_thread::sleep_for(std::chrono::microseconds(10)); // Yield a little
+            cycle_waiters.waitFor(target_cycle, &stop_batch);
         }
     }
 } 
@@ -229,9 +732,28 @@ void Scheduler::batchWorker() {
 //    }
 //}
 
+Scheduler::CoreState* Scheduler::createCoreState() {
+    return new (allocateLocal(sizeof(CoreState))) CoreState();
+}
+
+// Entry point of a dedicated worker: pin, then allocate the core's state
+// from the pinned thread so it is local to the worker's node
+void Scheduler::runCore(int core_id) {
+    pinCurrentThread("core " + std::to_string(core_id), affinity_plan.cores[core_id]);
+    if (affinity_plan.numa_local) {
+        core_state[core_id] = createCoreState();
+    }
+    threads_ready->count_down();
+    (this->*worker_function)(core_id);
+}
+
 void Scheduler::schedule() {
+    pinCurrentThread("dispatcher", affinity_plan.dispatcher);
+    // Dispatching touches every core's state, so wait until it all exists
+    threads_ready->arrive_and_wait();
     while (!stop_requested) {
-        std::unique_lock<std::mutex> lock(queue_mutex);
+        collectIoCompletions();
+        std::unique_lock<InstrumentedMutex> lock(queue_mutex);
         if (!process_queue.empty()) {
             Process* p = process_queue.front();
             process_queue.pop();
@@ -239,21 +761,38 @@ void Scheduler::schedule() {
 
             bool assigned = false;
             while (!assigned && !stop_requested) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                std::lock_guard<std::mutex> core_lock(cores_mutex);
-                for (int i = 0; i < num_cores; i++) {
-                    if (cores[i] == nullptr) {
-                        cores[i] = p;
-                        p->state = ProcessState::Running;
-                        p->core_id = i;
-                        quantum_counters[i] = 0;
-                        if (p->start_time.time_since_epoch().count() == 0) {
-                            p->start_time = std::chrono::system_clock::now();
+                int core = -1;
+                {
+                    ProfileScope profile(ProfileZone::Dispatch);
+                    std::lock_guard<InstrumentedMutex> core_lock(cores_mutex);
+                    for (int i = 0; i < num_cores; i++) {
+                        if (cores[i] == nullptr) {
+                            cores[i] = p;
+                            p->state = ProcessState::Running;
+                            p->core_id = i;
+                            core_state[i]->quantum = 0;
+                            dispatch_count++;
+                            recordDispatch(i, p);
+                            traceEvent(TraceEventType::Dispatch, i, p->pid);
+                            if (p->start_time.time_since_epoch().count() == 0) {
+                                p->start_time = std::chrono::system_clock::now();
+                            }
+                            assigned = true;
+                            core = i;
+                            break;
                         }
-                        assigned = true;
-                        break;
                     }
                 }
+                if (assigned) {
+                    if (execution_mode == "pool") {
+                        core_pool.wake(core);
+                    }
+                }
+                else {
+                    // Every core is busy; retry shortly
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                    collectIoCompletions();
+                }
             }
         }
         else {
@@ -270,7 +809,7 @@ void Scheduler::worker(int core_id) {
 
         // Check if core has a process assigned
         {
-            std::lock_guard<std::mutex> lock(cores_mutex);
+            std::lock_guard<InstrumentedMutex> lock(cores_mutex);
             p = cores[core_id];
         }
 
@@ -288,11 +827,11 @@ void Scheduler::worker(int core_id) {
                 // Process finished
                 p->state = ProcessState::Finished;
                 {
-                    std::lock_guard<std::mutex> lock(finished_mutex);
+                    std::lock_guard<InstrumentedMutex> lock(finished_mutex);
                     finished_processes.push_back(p);
                 }
                 {
-                    std::lock_guard<std::mutex> lock(cores_mutex);
+                    std::lock_guard<InstrumentedMutex> lock(cores_mutex);
                     cores[core_id] = nullptr;
                 }
                 quantum_counters[core_id] = 0; // Reset counter
@@ -306,12 +845,12 @@ void Scheduler::worker(int core_id) {
                 if (quantum_counters[core_id] >= quantum_cycles) {
                     // Preempt process
                     {
-                        std::lock_guard<std::mutex> lock(queue_mutex);
+                        std::lock_guard<InstrumentedMutex> lock(queue_mutex);
                         process_queue.push(p);
                         p->state = ProcessState::Waiting;
                     }
                     {
-                        std::lock_guard<std::mutex> lock(cores_mutex);
+                        std::lock_guard<InstrumentedMutex> lock(cores_mutex);
                         cores[core_id] = nullptr;
                     }
                     quantum_counters[core_id] = 0; // Reset counter
@@ -324,75 +863,256 @@ void Scheduler::worker(int core_id) {
     }
 }*/
 
+// Policy and delay are fixed once the scheduler starts, so the core loops
+// are instantiated per combination and bound here instead of re-checking
+// scheduler_type and delay_per_exec on every instruction.
+template <SchedulingPolicy Policy, DelayMode Delay>
+void Scheduler::bindCoreLoops() {
+    step_function = &Scheduler::stepCore<Policy, Delay>;
+    worker_function = &Scheduler::worker<Policy, Delay>;
+}
+
+void Scheduler::selectCoreLoops() {
+    if (!specialized_workers) {
+        bindCoreLoops<SchedulingPolicy::Dynamic, DelayMode::Dynamic>();
+    }
+    else if (policy == SchedulingPolicy::RR) {
+        if (delay_per_exec == 0) bindCoreLoops<SchedulingPolicy::RR, DelayMode::Zero>();
+        else bindCoreLoops<SchedulingPolicy::RR, DelayMode::Cycles>();
+    }
+    else {
+        if (delay_per_exec == 0) bindCoreLoops<SchedulingPolicy::FCFS, DelayMode::Zero>();
+        else bindCoreLoops<SchedulingPolicy::FCFS, DelayMode::Cycles>();
+    }
+}
+
+template <SchedulingPolicy Policy, DelayMode Delay>
 void Scheduler::worker(int core_id) {
     while (!stop_requested) {
-        Process* p = nullptr;
+        switch (stepCore<Policy, Delay>(core_id)) {
+        case CoreStep::Executed:
+            break;
+        case CoreStep::Busy:
+            // Simulate instruction execution delay
+            while (cpu_cycles < core_state[core_id]->busy_until && !stop_requested) {
+                cycle_waiters.waitFor(core_state[core_id]->busy_until, &stop_requested);
+            }
+            break;
+        case CoreStep::Sleeping:
+            // If process is sleeping, wait for its wake-up cycle
+            while (cpu_cycles < core_state[core_id]->sleep_until && !stop_requested) {
+                cycle_waiters.waitFor(core_state[core_id]->sleep_until, &stop_requested);
+            }
+            break;
+        case CoreStep::Idle:
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            break;
+        }
+    }
+}
 
-        // Check if core has a process assigned
-        {
-            std::lock_guard<std::mutex> lock(cores_mutex);
-            p = cores[core_id];
+// Runs one instruction on a core without blocking, so the same code drives
+// both a dedicated worker thread and a CorePool thread in M:N mode.
+template <SchedulingPolicy Policy, DelayMode Delay>
+CoreStep Scheduler::stepCore(int core_id) {
+    if constexpr (Delay != DelayMode::Zero) {
+        if (cpu_cycles < core_state[core_id]->busy_until) {
+            return CoreStep::Busy;
         }
+    }
 
-        if (p) {
-            // If process is sleeping, wait
-            if (p->isSleeping()) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(delay_per_exec));
-                continue;
-            }
+    Process* p = nullptr;
 
-            p->state = ProcessState::Running;
+    // Check if core has a process assigned
+    {
+        std::lock_guard<InstrumentedMutex> lock(cores_mutex);
+        p = cores[core_id];
+    }
 
-            // Execute one instruction
-            bool finished = p->executeNextInstruction(core_id);
+    if (!p) {
+        return CoreStep::Idle;
+    }
+    if (p->isSleeping()) {
+        core_state[core_id]->sleep_until = p->getSleepUntil();
+        return CoreStep::Sleeping;
+    }
 
-            // Simulate instruction execution delay
-            /*if (delay_per_exec > 0) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(delay_per_exec));
-            }*/
+    p->state = ProcessState::Running;
+
+    if constexpr (Policy == SchedulingPolicy::FCFS && Delay == DelayMode::Zero) {
+        // Nothing can take the core away: execute back to back until the
+        // process finishes, sleeps or blocks. The burst is capped so a CorePool
+        // thread still gets around to its other cores.
+        uint64_t executed = 0;
+        bool finished = false;
+        do {
+            finished = p->executeNextInstruction(core_id);
+            executed++;
+        } while (!finished && executed < FCFS_BURST && p->getSleepUntil() == 0
+            && !p->hasPendingIo() && !stop_requested);
+        instructions_executed += executed;
+        // Outstanding I/O first: a process that finished with requests in
+        // flight completes when they do
+        if (p->hasPendingIo()) {
+            blockOnIo(core_id, p);
+        }
+        else if (finished) {
+            finishOnCore(core_id, p);
+        }
+        return CoreStep::Executed;
+    }
+    else {
+        // Execute one instruction
+        bool finished = p->executeNextInstruction(core_id);
+        instructions_executed++;
+
+        // The core stays busy for delay_per_exec cycles after this instruction
+        if constexpr (Delay == DelayMode::Cycles) {
+            core_state[core_id]->busy_until = cpu_cycles + delay_per_exec;
+        }
+        else if constexpr (Delay == DelayMode::Dynamic) {
             if (delay_per_exec > 0) {
-                uint64_t target_cycle = cpu_cycles + delay_per_exec;
-                while (cpu_cycles < target_cycle && !stop_requested) {
-                    std::this_thread::sleep_for(std::chrono::microseconds(10)); // yield slightly
-                }
+                core_state[core_id]->busy_until = cpu_cycles + delay_per_exec;
             }
+        }
 
-            if (finished) {
-                // Process finished
-                p->state = ProcessState::Finished;
-                {
-                    std::lock_guard<std::mutex> lock(finished_mutex);
-                    finished_processes.push_back(p);
-                }
-                {
-                    std::lock_guard<std::mutex> lock(cores_mutex);
-                    cores[core_id] = nullptr;
-                }
-                quantum_counters[core_id] = 0; // Reset counter
-                continue;
-            }
+        if (p->hasPendingIo()) {
+            blockOnIo(core_id, p);
+            return CoreStep::Executed;
+        }
+        if (finished) {
+            finishOnCore(core_id, p);
+            return CoreStep::Executed;
+        }
 
-            // Round Robin preemption check
-            if (scheduler_type == "rr") {
-                quantum_counters[core_id]++;
+        // Round Robin preemption check
+        bool round_robin = Policy == SchedulingPolicy::RR;
+        if constexpr (Policy == SchedulingPolicy::Dynamic) {
+            round_robin = scheduler_type == "rr";
+        }
+        if (round_robin) {
+            core_state[core_id]->quantum++;
 
-                if (quantum_counters[core_id] >= quantum_cycles) {
-                    // Preempt process
-                    {
-                        std::lock_guard<std::mutex> lock(queue_mutex);
-                        process_queue.push(p);
-                        p->state = ProcessState::Waiting;
-                    }
-                    {
-                        std::lock_guard<std::mutex> lock(cores_mutex);
-                        cores[core_id] = nullptr;
-                    }
-                    quantum_counters[core_id] = 0; // Reset counter
-                }
+            int cls = static_cast<int>(p->quantum_class.load(std::memory_order_relaxed));
+            if (core_state[core_id]->quantum >= class_quantum[cls].load(std::memory_order_relaxed)) {
+                preemptOnCore(core_id, p);
             }
         }
+        return CoreStep::Executed;
+    }
+}
+
+void Scheduler::finishOnCore(int core_id, Process* p) {
+    // Off the core before the finished list, where the archiver may take it
+    {
+        std::lock_guard<InstrumentedMutex> lock(cores_mutex);
+        cores[core_id] = nullptr;
+    }
+    core_state[core_id]->quantum = 0; // Reset counter
+    finishProcess(core_id, p);
+}
+
+// core_id is -1 for a process finished off-core, when the I/O issued by its
+// last statement completes
+void Scheduler::finishProcess(int core_id, Process* p) {
+    p->state = ProcessState::Finished;
+    admission.release(p);
+    traceEvent(TraceEventType::Finish, core_id, p->pid);
+    {
+        std::lock_guard<InstrumentedMutex> lock(finished_mutex);
+        finished_processes.push_back(p);
+    }
+    finished_count++;
+}
+
+// Called with cores_mutex held as p takes core_id. A core freed by a
+// preemption stayed idle until now, which is the cost of that switch.
+void Scheduler::recordDispatch(int core_id, Process* p) {
+    auto now = std::chrono::steady_clock::now();
+    int cls = static_cast<int>(p->quantum_class.load());
+    class_dispatches[cls]++;
+    class_wait_ns[cls] += std::chrono::duration_cast<std::chrono::nanoseconds>(now - p->queued_at).count();
+    if (core_state[core_id]->preempted_at != std::chrono::steady_clock::time_point{}) {
+        class_switch_ns[static_cast<int>(core_state[core_id]->preempted_class)] +=
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now - core_state[core_id]->preempted_at).count();
+        core_state[core_id]->preempted_at = {};
+    }
+}
+
+QuantumSample Scheduler::sampleQuantum() {
+    QuantumSample sample;
+    for (int c = 0; c < QUANTUM_CLASSES; c++) {
+        sample.classes[c].dispatches = class_dispatches[c];
+        sample.classes[c].wait_ns = class_wait_ns[c];
+        sample.classes[c].preemptions = class_preemptions[c];
+        sample.classes[c].switch_ns = class_switch_ns[c];
+    }
+    sample.instructions = instructions_executed;
+    sample.queue_depth = getQueueSize();
+    sample.num_cores = num_cores;
+    return sample;
+}
+
+// The process leaves the core at once so it can run something else while
+// the devices work; schedule() requeues it when its requests complete.
+void Scheduler::blockOnIo(int core_id, Process* p) {
+    p->state = ProcessState::Blocked;
+    p->quantum_class = QuantumClass::Interactive;
+    traceEvent(TraceEventType::Block, core_id, p->pid);
+    {
+        std::lock_guard<InstrumentedMutex> lock(cores_mutex);
+        cores[core_id] = nullptr;
+    }
+    core_state[core_id]->quantum = 0; // Reset counter
+    io.submit(p, p->takeIoRequests());
+}
+
+void Scheduler::collectIoCompletions() {
+    std::vector<Process*> ready;
+    io.collectCompletions(cpu_cycles, ready);
+    if (ready.empty()) return;
+    // A process whose last statement was the READ/WRITE has nothing left to
+    // run; it finishes here instead of taking a core again
+    std::vector<Process*> requeue;
+    for (Process* p : ready) {
+        if (p->isDone()) {
+            p->end_time = std::chrono::system_clock::now();
+            finishProcess(-1, p);
+        }
         else {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            requeue.push_back(p);
         }
     }
-}
\ No newline at end of file
+    std::lock_guard<InstrumentedMutex> lock(queue_mutex);
+    auto now = std::chrono::steady_clock::now();
+    for (Process* p : requeue) {
+        p->state = ProcessState::Waiting;
+        p->queued_at = now;
+        process_queue.push(p);
+    }
+}
+
+void Scheduler::preemptOnCore(int core_id, Process* p) {
+    // Preempt process
+    ProfileScope profile(ProfileZone::Preempt);
+    // The switch is charged to the class whose quantum ran out; having
+    // used a whole quantum, the process counts as CPU-bound from now on
+    QuantumClass cls = p->quantum_class.exchange(QuantumClass::Cpu);
+    auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<InstrumentedMutex> lock(queue_mutex);
+        p->queued_at = now;
+        process_queue.push(p);
+        p->state = ProcessState::Waiting;
+    }
+    preempt_count++;
+    class_preemptions[static_cast<int>(cls)]++;
+    traceEvent(TraceEventType::Preempt, core_id, p->pid);
+    {
+        std::lock_guard<InstrumentedMutex> lock(cores_mutex);
+        cores[core_id] = nullptr;
+        core_state[core_id]->preempted_at = now;
+        core_state[core_id]->preempted_class = cls;
+    }
+    core_state[core_id]->quantum = 0; // Reset counter
+}
@@ -2,6 +2,18 @@
 #define SCHEDULER_H
 
 #include "process.h"
+#include "metrics.h"
+#include "generator.h"
+#include "core_pool.h"
+#include "stats_segment.h"
+#include "control.h"
+#include "workload.h"
+#include "admission.h"
+#include "io.h"
+#include "lock_stats.h"
+#include "archive.h"
+#include "quantum.h"
+#include "affinity.h"
 #include <thread>
 #include <mutex>
 #include <queue>
@@ -13,6 +25,22 @@
 #include <format>
 #include <fstream>
 #include <random>
+#include <functional>
+#include <memory>
+#include <latch>
+
+enum class AddResult { Added, Exists, Rejected };
+
+// Copy of a core's occupant, taken under the cores lock
+struct CoreOccupant {
+    uint32_t pid = 0;               // 0: idle core
+    std::string name;
+    bool sleeping = false;
+};
+
+enum class SchedulingPolicy { FCFS, RR, Dynamic };
+// Zero: no per-instruction delay; Cycles: delay_per_exec > 0
+enum class DelayMode { Zero, Cycles, Dynamic };
 
 class Scheduler {
 public:
@@ -21,29 +49,87 @@ public:
 
     void start();
     void stop();
-    void addProcess(Process* process);
-    Process* getProcess(const std::string& name);
+    // Returns false if admission control refused the process (reason says
+    // which limit); the caller still owns it then
+    bool addProcess(Process* process, std::string* reason = nullptr);
+    // Like addProcess, but also refuses a name already in use
+    AddResult tryAddProcess(Process* process);
+    // For generated arrivals: applies the admission policy, waiting for room
+    // under "throttle" (until stop is set) and refusing at once under "shed"
+    AddResult submitProcess(Process* process, bool unique, const std::atomic<bool>* stop);
+    // Takes a process admitted by another instance; never refused
+    void adoptProcess(Process* process);
+    // Processes can be archived or migrated away (and freed) at any time, so
+    // they are only handed out with the process table locked: fn runs under
+    // it and must not call back into the scheduler. Returns false if there
+    // is no such process.
+    bool withProcess(const std::string& name, const std::function<void(Process&)>& fn);
+    bool hasProcess(const std::string& name);
+    // Same locking as withProcess; stops early once fn returns false
+    void forEachProcess(const std::function<bool(Process&)>& fn);
+    // Finished processes that were moved to the archive and freed
+    bool isArchived(const std::string& name) { return archive.contains(name); }
+    bool getArchived(const std::string& name, ArchivedProcess& record) { return archive.find(name, record); }
     int getActiveCores();
     int getQueueSize();
     void printStatus(bool toFile = false);
-    std::vector<uint64_t> quantum_counters;
+    void writeStatus(std::ostream& out);
+    // Removes up to max waiting processes for migration; the caller owns them
+    std::vector<Process*> takeQueued(size_t max);
+    MetricsSample sampleMetrics();
+    void printGeneratorStats();
+    void printAdmissionStats();
+    void printIoStats();
+    // Host memory by process state, plus the top heaviest processes
+    void printMemoryStats(size_t top = 10);
+    // Snapshot for the stats segment, one entry per core
+    std::vector<CoreOccupant> getCoreOccupants();
 
     static std::string formatTimePoint(const std::chrono::system_clock::time_point& tp);
 
     // Configuration methods
-    void setSchedulerType(const std::string& type) { scheduler_type = type; }
-    void setQuantumCycles(uint64_t quantum) { quantum_cycles = quantum; }
+    void setSchedulerType(const std::string& type) {
+        scheduler_type = type;
+        policy = type == "rr" ? SchedulingPolicy::RR : SchedulingPolicy::FCFS;
+    }
+    void setQuantumCycles(uint64_t quantum) {
+        quantum_cycles = quantum;
+        for (auto& q : class_quantum) q = quantum;
+    }
+    void setQuantumConfig(const QuantumConfig& config) { quantum_config = config; }
     void setMinInstructions(uint64_t min) { min_instructions = min; }
     void setMaxInstructions(uint64_t max) { max_instructions = max; }
     void setBatchFrequency(uint64_t freq) { batch_frequency = freq; }
     void setDelay(uint64_t delay) { delay_per_exec = delay; }
+    void setMetricsConfig(const MetricsConfig& config) { metrics_config = config; }
+    void setArrivalConfig(const ArrivalConfig& config) { arrival_config = config; }
+    void setStatsConfig(const StatsConfig& config) { stats_config = config; }
+    void setControlConfig(const ControlConfig& config) { control_config = config; }
+    void setAdmissionConfig(const AdmissionConfig& config) { admission.configure(config); }
+    void setIoConfig(const IoConfig& config) { io.configure(config); }
+    void setArchiveConfig(const ArchiveConfig& config) { archive_config = config; }
+    // Replaces the synthetic generator with arrivals replayed from a trace
+    void setWorkloadFile(const std::string& path) { workload_file = path; }
+    void setExecutionMode(const std::string& mode) { execution_mode = mode; }
+    void setPoolThreads(int threads) { pool_threads = threads; }
+    void setAffinityConfig(const AffinityConfig& config) { affinity_config = config; }
+    // false: run the runtime-checked (Dynamic) core loop, for comparison
+    void setSpecializedWorkers(bool enabled) { specialized_workers = enabled; }
 
     // Add getter methods for private members
     uint64_t getQuantumCycles() const { return quantum_cycles; }
+
+    // Round-robin quantum in effect per class; the quantum controller
+    // moves these at runtime, otherwise they stay at quantum_cycles
+    uint64_t getClassQuantum(QuantumClass c) const { return class_quantum[static_cast<int>(c)]; }
+    void setClassQuantum(QuantumClass c, uint64_t quantum) { class_quantum[static_cast<int>(c)] = quantum; }
+    QuantumSample sampleQuantum();
+    void printQuantumStats() { quantum_controller.printStats(this); }
     uint64_t getMinInstructions() const { return min_instructions; }
     uint64_t getMaxInstructions() const { return max_instructions; }
+    int getPoolThreadCount() const { return core_pool.getThreadCount(); }
 
-    void startBatchProcess();
+    bool startBatchProcess();
     void stopBatchProcess();
     bool isBatchRunning() const { return batch_running; }
 
@@ -52,14 +138,38 @@ private:
     std::vector<Process*> cores;
     std::queue<Process*> process_queue;
     std::list<Process*> finished_processes;
-    std::mutex queue_mutex;
-    std::mutex cores_mutex;
-    std::mutex finished_mutex;
-    std::mutex all_processes_mutex;
+    InstrumentedMutex queue_mutex{ "sched.queue" };
+    InstrumentedMutex cores_mutex{ "sched.cores" };
+    InstrumentedMutex finished_mutex{ "sched.finished" };
+    InstrumentedMutex all_processes_mutex{ "sched.processes" };
     std::map<std::string, Process*> all_processes;
 
     std::thread scheduler_thread;
     std::vector<std::thread> workers;
+
+    // Per-core state, written mostly by the core's own thread. Each core
+    // gets its own page; with numa-local the pinned worker allocates it, so
+    // the page lands on that worker's node.
+    struct CoreState {
+        uint64_t quantum = 0;
+        uint64_t busy_until = 0;
+        uint64_t sleep_until = 0;
+        // Switch cost: when and from which class the core was last preempted
+        std::chrono::steady_clock::time_point preempted_at;
+        QuantumClass preempted_class = QuantumClass::Cpu;
+    };
+    std::vector<CoreState*> core_state;
+
+    // Host CPU placement; the dispatcher waits on threads_ready until every
+    // pinned thread has checked in
+    AffinityConfig affinity_config;
+    AffinityPlan affinity_plan;
+    std::unique_ptr<std::latch> threads_ready;
+
+    // M:N execution: emulated cores are stepped by a fixed-size pool
+    std::string execution_mode = "threads";
+    int pool_threads = 0;
+    CorePool core_pool;
     std::atomic<bool> stop_requested;
     bool is_running;
 
@@ -68,16 +178,69 @@ private:
     std::atomic<bool> batch_running{ false };
     std::atomic<bool> stop_batch{ false };
     std::string scheduler_type = "fcfs";
+    SchedulingPolicy policy = SchedulingPolicy::FCFS;
     uint64_t quantum_cycles = 5;
+    std::atomic<uint64_t> class_quantum[QUANTUM_CLASSES];
+    QuantumConfig quantum_config;
+    QuantumController quantum_controller;
+    std::atomic<uint64_t> class_dispatches[QUANTUM_CLASSES] = {};
+    std::atomic<uint64_t> class_wait_ns[QUANTUM_CLASSES] = {};
+    std::atomic<uint64_t> class_preemptions[QUANTUM_CLASSES] = {};
+    std::atomic<uint64_t> class_switch_ns[QUANTUM_CLASSES] = {};
     uint64_t batch_frequency = 1;
     uint64_t min_instructions = 1;
     uint64_t max_instructions = 2000;
     uint64_t delay_per_exec = 100;
     std::atomic<int> process_counter{ 1 };
+    ArrivalConfig arrival_config;
+    ProcessGenerator generator;
+    std::string workload_file;
+    WorkloadReplay workload;
+    AdmissionController admission;
+    IoSubsystem io;
+
+    // Finished-process archive
+    ArchiveConfig archive_config;
+    ProcessArchive archive;
+    std::thread archive_thread;
+    std::atomic<bool> stop_archive{ false };
+
+    // Counters for the metrics sampler
+    std::atomic<uint64_t> instructions_executed{ 0 };
+    std::atomic<uint64_t> dispatch_count{ 0 };
+    std::atomic<uint64_t> preempt_count{ 0 };
+    std::atomic<uint64_t> finished_count{ 0 };
+    MetricsConfig metrics_config;
+    MetricsSampler metrics_sampler;
+    StatsConfig stats_config;
+    StatsPublisher stats_publisher;
+    ControlConfig control_config;
+    ControlServer control_server;
+
+    // Core loops, instantiated per policy and delay mode (see selectCoreLoops)
+    static constexpr uint64_t FCFS_BURST = 1024;
+    bool specialized_workers = true;
+    CoreStep (Scheduler::*step_function)(int) = nullptr;
+    void (Scheduler::*worker_function)(int) = nullptr;
 
     void schedule();
-    void worker(int core_id);
+    void runCore(int core_id);
+    static CoreState* createCoreState();
+    void selectCoreLoops();
+    template <SchedulingPolicy Policy, DelayMode Delay> void bindCoreLoops();
+    template <SchedulingPolicy Policy, DelayMode Delay> void worker(int core_id);
+    template <SchedulingPolicy Policy, DelayMode Delay> CoreStep stepCore(int core_id);
+    void finishOnCore(int core_id, Process* p);
+    void finishProcess(int core_id, Process* p);
+    void preemptOnCore(int core_id, Process* p);
+    void blockOnIo(int core_id, Process* p);
+    void recordDispatch(int core_id, Process* p);
+    void collectIoCompletions();
     void batchWorker();
+    void archiveWorker();
+    AddResult insert(Process* process, bool unique, std::string* reason);
+    AddResult registerAdmitted(Process* process, bool unique);
+    void enqueue(Process* process);
 };
 
 #endif // SCHEDULER_H
\ No newline at end of file
@@ -0,0 +1,540 @@
+#include "shard.h"
+#include "ipc.h"
+#include "cycle_clock.h"
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include <random>
+#include <algorithm>
+#include <cstdio>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+namespace {
+    // Splits "VERB arg\npayload"
+    void parseRequest(const std::string& message, std::string& verb, std::string& arg,
+        std::string& payload)
+    {
+        size_t newline = message.find('\n');
+        std::istringstream iss(message.substr(0, newline));
+        iss >> verb >> arg;
+        payload = newline == std::string::npos ? "" : message.substr(newline + 1);
+    }
+
+    std::string describeArchived(const ArchivedProcess& record) {
+        std::ostringstream out;
+        out << "Process name: " << record.name << std::endl;
+        out << "Logs:" << std::endl;
+        for (const auto& log : record.logs) {
+            out << log;
+        }
+        out << "\nCurrent instruction line: " << record.total_instructions << std::endl;
+        out << "Lines of code: " << record.total_instructions << std::endl;
+        out << "\nFinished!" << std::endl;
+        return out.str();
+    }
+
+    std::string describeProcess(Process& p) {
+        std::ostringstream out;
+        out << "Process name: " << p.name << std::endl;
+        out << "Logs:" << std::endl;
+        for (const auto& log : p.getLogMessages()) {
+            out << log;
+        }
+        int remaining = p.remaining_instructions.load();
+        out << "\nCurrent instruction line: " << (p.total_instructions - remaining) << std::endl;
+        out << "Lines of code: " << p.total_instructions << std::endl;
+        if (p.state == ProcessState::Finished) {
+            out << "\nFinished!" << std::endl;
+        }
+        return out.str();
+    }
+
+    // Processes handed out by STEAL wait here, off the queue, until the
+    // front-end reports whether the receiving shard took them
+    using Outgoing = std::map<std::string, Process*>;
+
+    std::string handleRequest(Scheduler& scheduler, Outgoing& outgoing, const std::string& message) {
+        std::string verb, arg, payload;
+        parseRequest(message, verb, arg, payload);
+
+        if (verb == "CREATE") {
+            if (arg.empty() || scheduler.hasProcess(arg) || scheduler.isArchived(arg) || outgoing.count(arg)) {
+                return "EXISTS";
+            }
+            std::random_device rd;
+            std::mt19937 gen(rd());
+            std::uniform_int_distribution<uint64_t> dist(
+                scheduler.getMinInstructions(), scheduler.getMaxInstructions());
+            Process* p = new Process(arg, static_cast<int>(dist(gen)));
+            std::string reason;
+            if (!scheduler.addProcess(p, &reason)) {
+                delete p;
+                return "REJECTED " + reason;
+            }
+            return "OK";
+        }
+        else if (verb == "QUERY") {
+            std::string description;
+            if (scheduler.withProcess(arg, [&](Process& p) { description = describeProcess(p); })) {
+                return "OK\n" + description;
+            }
+            // Held here between STEAL and COMMIT/ABORT, so owned by this thread
+            auto in_transit = outgoing.find(arg);
+            if (in_transit != outgoing.end()) {
+                return "OK\n" + describeProcess(*in_transit->second);
+            }
+            ArchivedProcess record;
+            if (scheduler.getArchived(arg, record)) {
+                return "OK\n" + describeArchived(record);
+            }
+            return "MISSING";
+        }
+        else if (verb == "STATUS") {
+            MetricsSample sample = scheduler.sampleMetrics();
+            ShardStatus status;
+            status.cores = sample.num_cores;
+            status.active = sample.active_cores;
+            status.running = sample.running;
+            status.queued = sample.queue_depth;
+            status.finished = sample.finished;
+            ByteWriter out;
+            out.put(status);
+            return "OK\n" + out.data();
+        }
+        else if (verb == "LS") {
+            std::ostringstream out;
+            scheduler.writeStatus(out);
+            return "OK\n" + out.str();
+        }
+        else if (verb == "STEAL") {
+            size_t count = arg.empty() ? 1 : std::stoul(arg);
+            std::vector<std::string> blobs;
+            for (Process* p : scheduler.takeQueued(count)) {
+                blobs.push_back(p->serialize());
+                outgoing[p->name] = p;
+            }
+            ByteWriter out;
+            out.putStrings(blobs);
+            return "OK\n" + out.data();
+        }
+        else if (verb == "COMMIT" || verb == "ABORT") {
+            // COMMIT: the receiver has them, free ours. ABORT: queue them again.
+            ByteReader in(payload);
+            for (const std::string& name : in.getStrings()) {
+                auto it = outgoing.find(name);
+                if (it == outgoing.end()) continue;
+                if (verb == "COMMIT") {
+                    delete it->second;
+                }
+                else {
+                    scheduler.adoptProcess(it->second);
+                }
+                outgoing.erase(it);
+            }
+            return "OK";
+        }
+        else if (verb == "IMPORT") {
+            ByteReader in(payload);
+            int imported = 0;
+            std::vector<std::string> dropped;
+            for (const std::string& blob : in.getStrings()) {
+                Process* p = Process::deserialize(blob);
+                if (!p) {
+                    ByteReader name_reader(blob);
+                    dropped.push_back(name_reader.getString());
+                    continue;
+                }
+                if (scheduler.hasProcess(p->name) || scheduler.isArchived(p->name) || outgoing.count(p->name)) {
+                    dropped.push_back(p->name);
+                    delete p;
+                    continue;
+                }
+                scheduler.adoptProcess(p);
+                imported++;
+            }
+            ByteWriter out;
+            out.putStrings(dropped);
+            return "OK " + std::to_string(imported) + "\n" + out.data();
+        }
+        return "ERR unknown request '" + verb + "'";
+    }
+}
+
+int shardIndex(const std::string& socket_path) {
+    std::string stem = std::filesystem::path(socket_path).stem().string();
+    size_t dash = stem.rfind('-');
+    try {
+        return dash == std::string::npos ? 0 : std::stoi(stem.substr(dash + 1));
+    }
+    catch (const std::exception&) {
+        return 0;
+    }
+}
+
+int runShardServer(Scheduler& scheduler, const std::string& socket_path) {
+    int listen_fd = ipcListen(socket_path);
+    if (listen_fd < 0) {
+        std::cerr << "Shard: could not listen on " << socket_path << std::endl;
+        return 1;
+    }
+    // Exactly one client: the front-end that spawned us
+    int fd = ipcAccept(listen_fd);
+    ipcClose(listen_fd);
+    std::remove(socket_path.c_str());
+
+    Outgoing outgoing;
+    std::string message;
+    while (fd >= 0 && ipcReceive(fd, message)) {
+        if (message == "EXIT") {
+            ipcSend(fd, "OK");
+            break;
+        }
+        std::string reply;
+        try {
+            reply = handleRequest(scheduler, outgoing, message);
+        }
+        catch (const std::exception& e) {
+            reply = std::string("ERR ") + e.what();
+        }
+        if (!ipcSend(fd, reply)) break;
+    }
+    for (auto& entry : outgoing) {
+        delete entry.second;
+    }
+    ipcClose(fd);
+    return 0;
+}
+
+bool ShardCluster::start(int count, const std::string& exe_path) {
+#ifdef _WIN32
+    (void)count;
+    (void)exe_path;
+    return false;
+#else
+    if (!shards.empty() || count <= 0) return false;
+
+    std::string exe = exe_path;
+    std::error_code error;
+    auto self = std::filesystem::read_symlink("/proc/self/exe", error);
+    if (!error) {
+        exe = self.string();
+    }
+
+    for (int i = 0; i < count; i++) {
+        auto shard = std::make_unique<Shard>();
+        shard->socket = (std::filesystem::temp_directory_path() /
+            ("csopesy-shard-" + std::to_string(getpid()) + "-" + std::to_string(i) + ".sock")).string();
+        pid_t pid = fork();
+        if (pid == 0) {
+            execl(exe.c_str(), exe.c_str(), "--shard", shard->socket.c_str(), static_cast<char*>(nullptr));
+            _exit(127);
+        }
+        shard->pid = pid;
+        shards.push_back(std::move(shard));
+    }
+
+    // Give each shard a moment to read its config and start listening
+    bool connected = true;
+    for (auto& shard : shards) {
+        for (int attempt = 0; attempt < 250 && shard->fd < 0 && shard->pid > 0; attempt++) {
+            shard->fd = ipcConnect(shard->socket);
+            if (shard->fd < 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+        }
+        connected = connected && shard->fd >= 0;
+    }
+    if (!connected) {
+        stop();
+        return false;
+    }
+
+    stop_requested = false;
+    balancer_thread = std::thread(&ShardCluster::balance, this);
+    return true;
+#endif
+}
+
+void ShardCluster::stop() {
+    stopBatch();
+    stop_requested = true;
+    if (balancer_thread.joinable()) {
+        balancer_thread.join();
+    }
+#ifndef _WIN32
+    for (auto& shard : shards) {
+        std::string reply;
+        if (shard->fd >= 0) {
+            request(*shard, "EXIT", reply);
+            ipcClose(shard->fd);
+        }
+        else if (shard->pid > 0) {
+            kill(shard->pid, SIGTERM);
+        }
+        if (shard->pid > 0) {
+            waitpid(shard->pid, nullptr, 0);
+        }
+        std::remove(shard->socket.c_str());
+    }
+#endif
+    shards.clear();
+    std::lock_guard<std::mutex> lock(routes_mutex);
+    routes.clear();
+}
+
+bool ShardCluster::request(Shard& shard, const std::string& message, std::string& reply) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return ipcSend(shard.fd, message) && ipcReceive(shard.fd, reply);
+}
+
+bool ShardCluster::refreshStatus(Shard& shard) {
+    std::string reply;
+    if (!request(shard, "STATUS", reply) || !reply.starts_with("OK\n")) return false;
+    std::string payload = reply.substr(3);
+    ByteReader in(payload);
+    ShardStatus status = in.get<ShardStatus>();
+    if (!in.ok()) return false;
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.status = status;
+    return true;
+}
+
+// Lowest (queued + running) per core
+int ShardCluster::leastLoaded() {
+    int best = 0;
+    double best_load = 0;
+    for (size_t i = 0; i < shards.size(); i++) {
+        refreshStatus(*shards[i]);
+        ShardStatus s;
+        {
+            std::lock_guard<std::mutex> lock(shards[i]->mutex);
+            s = shards[i]->status;
+        }
+        double load = static_cast<double>(s.queued + s.running) / std::max(s.cores, 1);
+        if (i == 0 || load < best_load) {
+            best = static_cast<int>(i);
+            best_load = load;
+        }
+    }
+    return best;
+}
+
+int ShardCluster::createProcess(const std::string& name) {
+    if (shards.empty()) return -1;
+    // Reserve the name, then talk to the shards without holding the lock
+    {
+        std::lock_guard<std::mutex> lock(routes_mutex);
+        if (!routes.emplace(name, PENDING_ROUTE).second) return -1;
+    }
+    int index = leastLoaded();
+    std::string reply;
+    bool created = request(*shards[index], "CREATE " + name, reply) && reply == "OK";
+
+    std::lock_guard<std::mutex> lock(routes_mutex);
+    if (!created) {
+        routes.erase(name);
+        return reply.starts_with("REJECTED") ? -2 : -1;
+    }
+    // The balancer may already have moved it and recorded the new shard
+    auto it = routes.find(name);
+    if (it != routes.end() && it->second == PENDING_ROUTE) {
+        it->second = index;
+    }
+    return index;
+}
+
+bool ShardCluster::queryProcess(const std::string& name, std::string& description) {
+    int index;
+    {
+        std::lock_guard<std::mutex> lock(routes_mutex);
+        auto it = routes.find(name);
+        if (it == routes.end() || it->second == PENDING_ROUTE) return false;
+        index = it->second;
+    }
+    std::string reply;
+    if (!request(*shards[index], "QUERY " + name, reply) || !reply.starts_with("OK\n")) return false;
+    description = "Shard: " + std::to_string(index) + "\n" + reply.substr(3);
+    return true;
+}
+
+void ShardCluster::writeStatus(std::ostream& out) {
+    ShardStatus total;
+    std::vector<ShardStatus> statuses;
+    for (auto& shard : shards) {
+        refreshStatus(*shard);
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        statuses.push_back(shard->status);
+        total.cores += shard->status.cores;
+        total.active += shard->status.active;
+        total.queued += shard->status.queued;
+        total.finished += shard->status.finished;
+    }
+    float utilization = total.cores > 0 ? 100.0f * total.active / total.cores : 0.0f;
+
+    out << "--------------------------------------" << std::endl;
+    out << "Shards: " << shards.size() << "     Migrations: " << migrations << std::endl;
+    out << "CPU Utilization: " << std::fixed << std::setprecision(0) << utilization << "%" << std::endl;
+    out << "Active Cores: " << total.active << std::endl;
+    out << "Cores Available: " << (total.cores - total.active) << std::endl;
+    out << "Processes in queue: " << total.queued << std::endl;
+    out << "Finished processes: " << total.finished << std::endl;
+
+    for (size_t i = 0; i < shards.size(); i++) {
+        std::string reply;
+        out << "\n== Shard " << i << " (pid " << shards[i]->pid << ", "
+            << statuses[i].cores << " cores) ==" << std::endl;
+        if (request(*shards[i], "LS", reply) && reply.starts_with("OK\n")) {
+            out << reply.substr(3);
+        }
+        else {
+            out << "(not responding)" << std::endl;
+        }
+    }
+}
+
+// Moves waiting processes from the most backed-up shard to one with idle
+// cores and an empty queue
+void ShardCluster::balance() {
+    while (!stop_requested) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (shards.size() < 2) continue;
+
+        std::vector<ShardStatus> statuses;
+        for (auto& shard : shards) {
+            refreshStatus(*shard);
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            statuses.push_back(shard->status);
+        }
+
+        int donor = -1, receiver = -1;
+        for (size_t i = 0; i < statuses.size(); i++) {
+            if (donor < 0 || statuses[i].queued > statuses[donor].queued) {
+                donor = static_cast<int>(i);
+            }
+            int idle = statuses[i].cores - statuses[i].running;
+            if (statuses[i].queued == 0 && idle > 0
+                && (receiver < 0 || idle > statuses[receiver].cores - statuses[receiver].running)) {
+                receiver = static_cast<int>(i);
+            }
+        }
+        if (receiver < 0 || donor == receiver || statuses[donor].queued < 2) continue;
+
+        int idle = statuses[receiver].cores - statuses[receiver].running;
+        int count = std::min(statuses[donor].queued / 2, idle);
+        std::string stolen;
+        if (!request(*shards[donor], "STEAL " + std::to_string(count), stolen)
+            || !stolen.starts_with("OK\n")) {
+            continue;
+        }
+        std::string payload = stolen.substr(3);
+        ByteReader in(payload);
+        std::vector<std::string> blobs = in.getStrings();
+        if (blobs.empty()) continue;
+        std::vector<std::string> names;
+        for (const std::string& blob : blobs) {
+            ByteReader name_reader(blob);
+            names.push_back(name_reader.getString());
+        }
+
+        // The donor holds the processes until told which ones arrived
+        std::string reply;
+        if (!request(*shards[receiver], "IMPORT\n" + payload, reply) || !reply.starts_with("OK")) {
+            std::cerr << "Shard " << receiver << " failed to import " << blobs.size()
+                << " migrated processes; returned them to shard " << donor << "." << std::endl;
+            settleMigration(*shards[donor], "ABORT", names);
+            continue;
+        }
+        size_t newline = reply.find('\n');
+        std::string dropped_payload = newline == std::string::npos ? "" : reply.substr(newline + 1);
+        ByteReader dropped_reader(dropped_payload);
+        std::vector<std::string> dropped = dropped_reader.getStrings();
+        std::vector<std::string> accepted;
+        for (const std::string& name : names) {
+            if (std::find(dropped.begin(), dropped.end(), name) == dropped.end()) {
+                accepted.push_back(name);
+            }
+        }
+        // Route lookups go to the receiver before the donor drops its copies
+        {
+            std::lock_guard<std::mutex> lock(routes_mutex);
+            for (const std::string& name : accepted) {
+                routes[name] = receiver;
+            }
+        }
+        settleMigration(*shards[donor], "COMMIT", accepted);
+        if (!dropped.empty()) {
+            settleMigration(*shards[donor], "ABORT", dropped);
+            std::cerr << "Shard " << receiver << " refused " << dropped.size()
+                << " migrated processes, returned to shard " << donor << ":";
+            for (const std::string& name : dropped) {
+                std::cerr << " " << name;
+            }
+            std::cerr << std::endl;
+        }
+
+        migrations += accepted.size();
+    }
+}
+
+// Second phase of a migration: COMMIT frees the donor's copies, ABORT
+// queues them on the donor again
+void ShardCluster::settleMigration(Shard& donor, const std::string& verb, const std::vector<std::string>& names) {
+    if (names.empty()) return;
+    ByteWriter out;
+    out.putStrings(names);
+    std::string reply;
+    if (!request(donor, verb + "\n" + out.data(), reply) || reply != "OK") {
+        std::cerr << "Shard did not confirm " << verb << " of " << names.size()
+            << " migrated processes." << std::endl;
+    }
+}
+
+void ShardCluster::startBatch(const ArrivalConfig& arrivals, uint64_t frequency) {
+    if (batch_running || shards.empty()) return;
+    stop_batch = false;
+    batch_running = true;
+    batch_thread = std::thread(&ShardCluster::batchWorker, this, arrivals, frequency);
+}
+
+void ShardCluster::stopBatch() {
+    if (!batch_running) return;
+    stop_batch = true;
+    cycle_waiters.wakeAll();
+    if (batch_thread.joinable()) {
+        batch_thread.join();
+    }
+    batch_running = false;
+}
+
+// Same arrival schedule as Scheduler::batchWorker, routed across shards
+void ShardCluster::batchWorker(ArrivalConfig arrivals, uint64_t frequency) {
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    ArrivalModel model(arrivals);
+    uint64_t period = 0;
+    uint64_t target_cycle = cpu_cycles;
+    frequency = std::max<uint64_t>(frequency, 1);
+
+    while (!stop_batch) {
+        uint64_t count = model.arrivals(period++, gen);
+        for (uint64_t i = 0; i < count && !stop_batch; i++) {
+            createProcess("p" + std::to_string(process_counter++));
+        }
+        target_cycle += frequency;
+        // Skip periods missed while stalled rather than catching up in a burst
+        uint64_t now_cycle = cpu_cycles;
+        if (target_cycle < now_cycle) {
+            uint64_t behind = (now_cycle - target_cycle) / frequency;
+            target_cycle += behind * frequency;
+            period += behind;
+        }
+        while (cpu_cycles < target_cycle && !stop_batch) {
+            cycle_waiters.waitFor(target_cycle, &stop_batch);
+        }
+    }
+}
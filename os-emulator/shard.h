@@ -0,0 +1,94 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include "scheduler.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <ostream>
+
+// Sharded mode: the console front-end spawns several copies of this program
+// with --shard, each running its own Scheduler, and talks to them over Unix
+// domain sockets. Requests are one framed message: a verb line, optionally
+// followed by a binary payload.
+//
+//   CREATE <name>        OK | EXISTS | REJECTED <reason>
+//   QUERY <name>         OK\n<process-smi text> | MISSING
+//   STATUS               OK\n<ShardStatus>
+//   LS                   OK\n<screen -ls text>
+//   STEAL <n>            OK\n<serialized processes>, held until COMMIT/ABORT
+//   IMPORT\n<processes>  OK <count>\n<names not imported>
+//   COMMIT\n<names>      OK (frees processes taken by STEAL)
+//   ABORT\n<names>       OK (queues them again)
+//   EXIT                 OK
+
+struct ShardStatus {
+    int32_t cores = 0;
+    int32_t active = 0;
+    int32_t running = 0;
+    int32_t queued = 0;
+    uint64_t finished = 0;
+};
+
+// Pids a shard numbers from: shard i starts at i * SHARD_PID_RANGE + 1, so a
+// process keeps a cluster-wide unique pid when it migrates
+constexpr uint32_t SHARD_PID_RANGE = 1u << 24;
+
+// Shard side: serves the front-end until EXIT or disconnect
+int runShardServer(Scheduler& scheduler, const std::string& socket_path);
+// Index of the shard listening on socket_path, from its "-<i>.sock" suffix
+int shardIndex(const std::string& socket_path);
+
+class ShardCluster {
+public:
+    ~ShardCluster() { stop(); }
+
+    bool start(int count, const std::string& exe_path);
+    void stop();
+    int getShardCount() const { return static_cast<int>(shards.size()); }
+
+    // Returns the shard the process was created on, -1 if it exists, or -2
+    // if the shard's admission control refused it
+    int createProcess(const std::string& name);
+    bool queryProcess(const std::string& name, std::string& description);
+    void writeStatus(std::ostream& out);
+
+    void startBatch(const ArrivalConfig& arrivals, uint64_t frequency);
+    void stopBatch();
+    bool isBatchRunning() const { return batch_running; }
+
+private:
+    struct Shard {
+        int pid = -1;
+        int fd = -1;
+        std::string socket;
+        std::mutex mutex;           // one request in flight per connection
+        ShardStatus status;         // last STATUS reply
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::mutex routes_mutex;
+    std::map<std::string, int> routes;      // process name -> shard index
+    static constexpr int PENDING_ROUTE = -1;    // name reserved, CREATE in flight
+    std::atomic<uint64_t> migrations{ 0 };
+
+    std::thread balancer_thread;
+    std::atomic<bool> stop_requested{ false };
+    std::thread batch_thread;
+    std::atomic<bool> batch_running{ false };
+    std::atomic<bool> stop_batch{ false };
+    std::atomic<int> process_counter{ 1 };
+
+    bool request(Shard& shard, const std::string& message, std::string& reply);
+    bool refreshStatus(Shard& shard);
+    int leastLoaded();
+    void balance();
+    void settleMigration(Shard& donor, const std::string& verb, const std::vector<std::string>& names);
+    void batchWorker(ArrivalConfig arrivals, uint64_t frequency);
+};
+
+#endif // SHARD_H
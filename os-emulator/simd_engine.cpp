@@ -0,0 +1,298 @@
+#include "simd_engine.h"
+#include <algorithm>
+#include <chrono>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_ENGINE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_ENGINE_SSE2
+#endif
+
+namespace {
+#if defined(SIMD_ENGINE_AVX2)
+    constexpr size_t VECTOR_LANES = 16;
+#elif defined(SIMD_ENGINE_SSE2)
+    constexpr size_t VECTOR_LANES = 8;
+#else
+    constexpr size_t VECTOR_LANES = 8;
+#endif
+
+    constexpr uint16_t OP_DECLARE = 1;
+    constexpr uint16_t OP_ADD = 2;
+    constexpr uint16_t OP_SUBTRACT = 3;
+
+    // out[i] = op[i] applied to (s[i], imm[i]), or d[i] if op[i] is NOP.
+    // ADD wraps and SUBTRACT saturates at 0, matching the scalar interpreter.
+    void applyChunk(const uint16_t* op, const uint16_t* s, const uint16_t* d,
+        const uint16_t* imm, uint16_t* out)
+    {
+#if defined(SIMD_ENGINE_AVX2)
+        __m256i vop = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(op));
+        __m256i vs = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s));
+        __m256i vd = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(d));
+        __m256i vimm = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(imm));
+        __m256i r = vd;
+        r = _mm256_blendv_epi8(r, vimm, _mm256_cmpeq_epi16(vop, _mm256_set1_epi16(OP_DECLARE)));
+        r = _mm256_blendv_epi8(r, _mm256_add_epi16(vs, vimm),
+            _mm256_cmpeq_epi16(vop, _mm256_set1_epi16(OP_ADD)));
+        r = _mm256_blendv_epi8(r, _mm256_subs_epu16(vs, vimm),
+            _mm256_cmpeq_epi16(vop, _mm256_set1_epi16(OP_SUBTRACT)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), r);
+#elif defined(SIMD_ENGINE_SSE2)
+        auto select = [](__m128i mask, __m128i a, __m128i b) {
+            return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+            };
+        __m128i vop = _mm_loadu_si128(reinterpret_cast<const __m128i*>(op));
+        __m128i vs = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+        __m128i vd = _mm_loadu_si128(reinterpret_cast<const __m128i*>(d));
+        __m128i vimm = _mm_loadu_si128(reinterpret_cast<const __m128i*>(imm));
+        __m128i r = vd;
+        r = select(_mm_cmpeq_epi16(vop, _mm_set1_epi16(OP_DECLARE)), vimm, r);
+        r = select(_mm_cmpeq_epi16(vop, _mm_set1_epi16(OP_ADD)), _mm_add_epi16(vs, vimm), r);
+        r = select(_mm_cmpeq_epi16(vop, _mm_set1_epi16(OP_SUBTRACT)), _mm_subs_epu16(vs, vimm), r);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), r);
+#else
+        for (size_t i = 0; i < VECTOR_LANES; i++) {
+            switch (op[i]) {
+            case OP_DECLARE: out[i] = imm[i]; break;
+            case OP_ADD: out[i] = static_cast<uint16_t>(s[i] + imm[i]); break;
+            case OP_SUBTRACT: out[i] = s[i] > imm[i] ? static_cast<uint16_t>(s[i] - imm[i]) : 0; break;
+            default: out[i] = d[i]; break;
+            }
+        }
+#endif
+    }
+}
+
+const char* SimdBatchEngine::instructionSet() {
+#if defined(SIMD_ENGINE_AVX2)
+    return "AVX2";
+#elif defined(SIMD_ENGINE_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+struct SimdBatchEngine::LaneEnv {
+    SimdBatchEngine& engine;
+    size_t lane;
+    int core_id;
+
+    uint16_t& var(uint8_t slot) {
+        return engine.vars[engine.lanes[lane].remap[slot] * engine.stride + lane];
+    }
+    void print(uint16_t constant) {
+        Process* p = engine.lanes[lane].process;
+        p->logPrint(p->program->constants[constant], core_id, std::chrono::system_clock::now());
+    }
+    void sleep(uint8_t) {}
+    void io(bool, uint8_t, uint16_t) {}
+};
+
+bool SimdBatchEngine::slotFor(const std::string& name, uint8_t& slot) {
+    auto it = slots.find(name);
+    if (it != slots.end()) {
+        slot = it->second;
+        return true;
+    }
+    if (slot_names.size() >= MAX_VARIABLES) return false;
+    slot = static_cast<uint8_t>(slot_names.size());
+    slots[name] = slot;
+    slot_names.push_back(name);
+    return true;
+}
+
+SimdBatchEngine::Statement SimdBatchEngine::decode(const Lane& lane, size_t pc) const {
+    const Op& op = lane.process->code[pc];
+    Statement stmt{ SCALAR, 0, 0, op.imm };
+
+    switch (op.code) {
+    case OpCode::Nop:
+    case OpCode::Sleep:
+        stmt.op = NOP;
+        break;
+    case OpCode::Declare:
+    case OpCode::ForDeclare:
+        stmt.op = DECLARE;
+        stmt.dst = lane.remap[op.a];
+        break;
+    case OpCode::Add:
+    case OpCode::Subtract:
+        stmt.op = op.code == OpCode::Add ? ADD : SUBTRACT;
+        stmt.dst = lane.remap[op.a];
+        stmt.src = lane.remap[op.b];
+        break;
+    case OpCode::ForAdd:
+    case OpCode::ForSubtract:
+        // A repeated "a = a op k" is one op with k scaled by the count;
+        // with distinct slots only the last iteration is visible.
+        stmt.op = op.code == OpCode::ForAdd ? ADD : SUBTRACT;
+        stmt.dst = lane.remap[op.a];
+        stmt.src = lane.remap[op.b];
+        if (op.a == op.b) {
+            uint64_t total = uint64_t(op.arg) * op.imm;
+            stmt.imm = op.code == OpCode::ForAdd ? static_cast<uint16_t>(total)
+                : static_cast<uint16_t>(std::min<uint64_t>(total, UINT16_MAX));
+        }
+        break;
+    default:
+        break;
+    }
+    return stmt;
+}
+
+bool SimdBatchEngine::load(const std::vector<Process*>& processes) {
+    lanes.clear();
+    slots.clear();
+    slot_names.clear();
+    scalar.clear();
+    statements = 0;
+
+    std::vector<std::vector<std::pair<Statement, uint32_t>>> programs;
+    steps = 0;
+    for (Process* p : processes) {
+        Lane lane;
+        lane.process = p;
+        for (const std::string& name : p->program->var_names) {
+            uint8_t slot;
+            if (!slotFor(name, slot)) return false;
+            lane.remap.push_back(slot);
+        }
+
+        std::vector<std::pair<Statement, uint32_t>> program;
+        size_t pc = p->current_instruction;
+        while (pc < p->code_size) {
+            program.push_back({ decode(lane, pc), static_cast<uint32_t>(pc) });
+            lane.lines += statementLines(p->code, pc);
+            pc += p->code[pc].code == OpCode::LoopBegin ? p->code[pc].arg + 1 : 1;
+        }
+        statements += program.size();
+        steps = std::max(steps, program.size());
+        programs.push_back(std::move(program));
+        lanes.push_back(std::move(lane));
+    }
+
+    stride = (lanes.size() + VECTOR_LANES - 1) / VECTOR_LANES * VECTOR_LANES;
+    chunks = stride / VECTOR_LANES;
+    vars.assign(std::max<size_t>(slot_names.size(), 1) * stride, 0);
+    for (size_t l = 0; l < lanes.size(); l++) {
+        const Process* p = lanes[l].process;
+        for (size_t slot = 0; slot < p->variables.size(); slot++) {
+            vars[lanes[l].remap[slot] * stride + l] = p->variables[slot];
+        }
+    }
+
+    step_op.assign(steps * stride, NOP);
+    step_imm.assign(steps * stride, 0);
+    step_dst.assign(steps * stride, 0);
+    step_src.assign(steps * stride, 0);
+    chunk_kind.assign(steps * chunks, CHUNK_EMPTY);
+    scalar_begin.assign(steps + 1, 0);
+
+    for (size_t k = 0; k < steps; k++) {
+        scalar_begin[k] = scalar.size();
+        for (size_t l = 0; l < lanes.size(); l++) {
+            if (k >= programs[l].size()) continue;
+            const auto& [stmt, pc] = programs[l][k];
+            if (stmt.op == SCALAR) {
+                scalar.push_back({ static_cast<uint32_t>(l), pc });
+                continue;
+            }
+            size_t i = k * stride + l;
+            step_op[i] = stmt.op;
+            step_imm[i] = stmt.imm;
+            step_dst[i] = stmt.dst;
+            step_src[i] = stmt.src;
+        }
+
+        // Classify each chunk once so the run loop only branches on the kind
+        for (size_t c = 0; c < chunks; c++) {
+            size_t base = k * stride + c * VECTOR_LANES;
+            int first = -1;
+            uint8_t kind = CHUNK_EMPTY;
+            for (size_t j = base; j < base + VECTOR_LANES; j++) {
+                if (step_op[j] == NOP) continue;
+                if (first < 0) {
+                    first = static_cast<int>(j);
+                    kind = CHUNK_UNIFORM;
+                }
+                else if (step_dst[j] != step_dst[first] || step_src[j] != step_src[first]) {
+                    kind = CHUNK_GATHER;
+                    break;
+                }
+            }
+            if (kind == CHUNK_UNIFORM) {
+                // NOP lanes rewrite their own value, so the rows can be shared
+                for (size_t j = base; j < base + VECTOR_LANES; j++) {
+                    step_dst[j] = step_dst[first];
+                    step_src[j] = step_src[first];
+                }
+            }
+            chunk_kind[k * chunks + c] = kind;
+        }
+    }
+    scalar_begin[steps] = scalar.size();
+    return true;
+}
+
+uint64_t SimdBatchEngine::run(int core_id) {
+    uint16_t tmp_s[VECTOR_LANES], tmp_d[VECTOR_LANES], tmp_out[VECTOR_LANES];
+
+    for (size_t k = 0; k < steps; k++) {
+        for (size_t i = scalar_begin[k]; i < scalar_begin[k + 1]; i++) {
+            LaneEnv env{ *this, scalar[i].lane, core_id };
+            executeStatement(lanes[scalar[i].lane].process->code, scalar[i].pc, env);
+        }
+
+        const size_t row = k * stride;
+        for (size_t c = 0; c < chunks; c++) {
+            const size_t base = c * VECTOR_LANES;
+            const size_t at = row + base;
+            switch (chunk_kind[k * chunks + c]) {
+            case CHUNK_EMPTY:
+                break;
+            case CHUNK_UNIFORM: {
+                // Every live lane reads and writes the same variable rows
+                uint16_t* d = &vars[step_dst[at] * stride + base];
+                const uint16_t* s = &vars[step_src[at] * stride + base];
+                applyChunk(&step_op[at], s, d, &step_imm[at], d);
+                break;
+            }
+            case CHUNK_GATHER:
+                for (size_t j = 0; j < VECTOR_LANES; j++) {
+                    tmp_s[j] = vars[step_src[at + j] * stride + base + j];
+                    tmp_d[j] = vars[step_dst[at + j] * stride + base + j];
+                }
+                applyChunk(&step_op[at], tmp_s, tmp_d, &step_imm[at], tmp_out);
+                for (size_t j = 0; j < VECTOR_LANES; j++) {
+                    vars[step_dst[at + j] * stride + base + j] = tmp_out[j];
+                }
+                break;
+            }
+        }
+    }
+    return statements;
+}
+
+void SimdBatchEngine::store() {
+    for (size_t l = 0; l < lanes.size(); l++) {
+        Lane& lane = lanes[l];
+        Process* p = lane.process;
+        for (size_t slot = 0; slot < p->variables.size(); slot++) {
+            p->variables[slot] = vars[lane.remap[slot] * stride + l];
+        }
+        p->current_instruction = p->code_size;
+        p->remaining_instructions -= static_cast<int>(lane.lines);
+        p->state = ProcessState::Finished;
+        p->end_time = std::chrono::system_clock::now();
+    }
+}
+
+uint16_t SimdBatchEngine::getVariable(size_t lane, const std::string& name) const {
+    auto it = slots.find(name);
+    if (it == slots.end() || lane >= lanes.size()) return 0;
+    return vars[it->second * stride + lane];
+}
@@ -0,0 +1,85 @@
+#ifndef SIMD_ENGINE_H
+#define SIMD_ENGINE_H
+
+#include "process.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+
+// Batch interpreter for arithmetic-heavy processes. Variables of all loaded
+// processes are kept in structure-of-arrays layout (one row per variable,
+// one lane per process) and DECLARE/ADD/SUBTRACT are applied across lanes
+// with 16-bit vector ops. Results match Process::executeNextInstruction:
+// ADD wraps at 16 bits and SUBTRACT saturates at 0.
+//
+// Statements that do not map onto a lane-wide op (loop nests, var+var forms,
+// PRINT) run through the shared scalar semantics on that lane's column. The
+// engine runs every loaded process to completion; SLEEP only affects timing,
+// which a batch run does not model, so it is treated as a no-op.
+//
+// Benchmark only: 'benchmark simd' is the sole user. No configuration or
+// execution mode schedules processes onto it, since it runs whole batches to
+// completion and cannot be preempted, blocked on I/O or migrated.
+class SimdBatchEngine {
+public:
+    static constexpr int MAX_VARIABLES = 32;
+
+    // Returns false if the processes use more than MAX_VARIABLES variable names
+    bool load(const std::vector<Process*>& processes);
+    uint64_t run(int core_id = 0);
+    void store();
+
+    uint16_t getVariable(size_t lane, const std::string& name) const;
+    size_t getLaneCount() const { return lanes.size(); }
+    static const char* instructionSet();
+
+private:
+    enum LaneOp : uint16_t { NOP = 0, DECLARE = 1, ADD = 2, SUBTRACT = 3, SCALAR = 4 };
+    enum ChunkKind : uint8_t { CHUNK_EMPTY, CHUNK_UNIFORM, CHUNK_GATHER };
+
+    // One executeNextInstruction call reduced to a lane-wide op
+    struct Statement {
+        uint16_t op;
+        uint8_t dst;
+        uint8_t src;
+        uint16_t imm;
+    };
+
+    struct Lane {
+        Process* process;
+        std::vector<uint8_t> remap;     // program variable slot -> engine row
+        uint64_t lines = 0;
+    };
+
+    struct ScalarStatement {
+        uint32_t lane;
+        uint32_t pc;
+    };
+
+    struct LaneEnv;
+
+    std::vector<Lane> lanes;
+    std::map<std::string, uint8_t> slots;
+    std::vector<std::string> slot_names;
+    size_t stride = 0;
+    size_t chunks = 0;
+    size_t steps = 0;
+    uint64_t statements = 0;
+    std::vector<uint16_t> vars;     // vars[row * stride + lane]
+
+    // The programs themselves are transposed: step k of every lane is
+    // contiguous, so the run loop never decodes anything.
+    std::vector<uint16_t> step_op;
+    std::vector<uint16_t> step_imm;
+    std::vector<uint8_t> step_dst;
+    std::vector<uint8_t> step_src;
+    std::vector<uint8_t> chunk_kind;            // [step * chunks + chunk]
+    std::vector<size_t> scalar_begin;           // [step] -> index into scalar
+    std::vector<ScalarStatement> scalar;
+
+    bool slotFor(const std::string& name, uint8_t& slot);
+    Statement decode(const Lane& lane, size_t pc) const;
+};
+
+#endif // SIMD_ENGINE_H
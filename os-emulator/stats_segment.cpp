@@ -0,0 +1,353 @@
+#include "stats_segment.h"
+#include "scheduler.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    void copyName(char* destination, const std::string& name) {
+        size_t length = std::min(name.size(), STATS_NAME_LENGTH - 1);
+        std::memcpy(destination, name.data(), length);
+        destination[length] = '\0';
+    }
+
+    uint64_t nowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    uint64_t currentPid() {
+#ifdef _WIN32
+        return GetCurrentProcessId();
+#else
+        return static_cast<uint64_t>(getpid());
+#endif
+    }
+}
+
+// ---------------------------------------------------------------------------
+// SharedMemory
+
+bool SharedMemory::create(const std::string& segment, size_t bytes) {
+    close();
+#ifdef _WIN32
+    std::string path = "Local\\" + segment;
+    HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        0, static_cast<DWORD>(bytes), path.c_str());
+    if (!mapping) return false;
+    address = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+    if (!address) {
+        CloseHandle(mapping);
+        return false;
+    }
+    handle = mapping;
+#else
+    std::string path = "/" + segment;
+    int fd = shm_open(path.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) return false;
+    if (ftruncate(fd, static_cast<off_t>(bytes)) < 0) {
+        ::close(fd);
+        shm_unlink(path.c_str());
+        return false;
+    }
+    void* mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        shm_unlink(path.c_str());
+        return false;
+    }
+    address = mapped;
+#endif
+    size = bytes;
+    name = path;
+    owner = true;
+    return true;
+}
+
+bool SharedMemory::open(const std::string& segment, size_t bytes) {
+    close();
+#ifdef _WIN32
+    std::string path = "Local\\" + segment;
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, path.c_str());
+    if (!mapping) return false;
+    address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, bytes);
+    if (!address) {
+        CloseHandle(mapping);
+        return false;
+    }
+    handle = mapping;
+#else
+    std::string path = "/" + segment;
+    int fd = shm_open(path.c_str(), O_RDONLY, 0);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) < 0 || static_cast<size_t>(info.st_size) < bytes) {
+        ::close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) return false;
+    address = mapped;
+#endif
+    size = bytes;
+    name = path;
+    owner = false;
+    return true;
+}
+
+void SharedMemory::close() {
+    if (!address) return;
+#ifdef _WIN32
+    UnmapViewOfFile(address);
+    CloseHandle(handle);
+    handle = nullptr;
+#else
+    munmap(address, size);
+    if (owner) {
+        shm_unlink(name.c_str());
+    }
+#endif
+    address = nullptr;
+}
+
+// ---------------------------------------------------------------------------
+// StatsPublisher
+
+bool StatsPublisher::start(Scheduler* sched, const StatsConfig& cfg) {
+    if (running || cfg.interval_ms == 0) return false;
+    if (!memory.create(cfg.segment, sizeof(StatsSegment))) {
+        std::cerr << "Could not create stats segment '" << cfg.segment << "'." << std::endl;
+        return false;
+    }
+    scheduler = sched;
+    config = cfg;
+
+    // A fresh mapping is zero-filled; stamp the layout before the first publish
+    auto* segment = static_cast<StatsSegment*>(memory.data());
+    segment->header.magic = STATS_MAGIC;
+    segment->header.version = STATS_VERSION;
+    segment->header.core_capacity = STATS_MAX_CORES;
+    segment->header.process_capacity = STATS_MAX_PROCESSES;
+    segment->header.writer_pid = currentPid();
+    segment->header.sequence.store(0, std::memory_order_release);
+
+    stop_requested = false;
+    running = true;
+    thread = std::thread(&StatsPublisher::run, this);
+    return true;
+}
+
+void StatsPublisher::stop() {
+    if (!running) return;
+    stop_requested = true;
+    if (thread.joinable()) {
+        thread.join();
+    }
+    memory.close();
+    running = false;
+}
+
+void StatsPublisher::run() {
+    auto* segment = static_cast<StatsSegment*>(memory.data());
+    auto next = std::chrono::steady_clock::now();
+    while (!stop_requested) {
+        publish(*segment);
+        next += std::chrono::milliseconds(config.interval_ms);
+        std::this_thread::sleep_until(next);
+    }
+}
+
+void StatsPublisher::publish(StatsSegment& segment) {
+    // Gather everything first so the odd (being-written) window stays short
+    MetricsSample sample = scheduler->sampleMetrics();
+    std::vector<CoreOccupant> occupants = scheduler->getCoreOccupants();
+    // Rows are copied with the process table locked; processes may be freed
+    // after. Waiting rows and then finished history only fill the slots left,
+    // so the scan stops once the table is full and every busy core's process
+    // has been seen
+    size_t busy = std::count_if(occupants.begin(), occupants.end(),
+        [](const CoreOccupant& occupant) { return occupant.pid != 0; });
+    std::vector<StatsProcess> running;
+    std::vector<StatsProcess> waiting;
+    std::vector<StatsProcess> history;
+    scheduler->forEachProcess([&](Process& p) {
+        ProcessState state = p.state.load();
+        size_t live = running.size() + waiting.size();
+        bool keep = state == ProcessState::Running
+            || (state == ProcessState::Finished ? live + history.size() : live) < STATS_MAX_PROCESSES;
+        if (keep) {
+            StatsProcess row{};
+            row.pid = p.pid;
+            row.core = static_cast<int16_t>(state == ProcessState::Running ? p.core_id.load() : -1);
+            row.state = static_cast<uint8_t>(state);
+            row.sleeping = p.isSleeping();
+            row.total = static_cast<uint32_t>(p.total_instructions);
+            row.done = static_cast<uint32_t>(std::max(0, p.total_instructions - p.remaining_instructions.load()));
+            copyName(row.name, p.name);
+            (state == ProcessState::Running ? running
+                : state == ProcessState::Finished ? history : waiting).push_back(row);
+        }
+        return running.size() + waiting.size() < STATS_MAX_PROCESSES || running.size() < busy;
+    });
+
+    uint32_t num_cores = static_cast<uint32_t>(std::min<size_t>(occupants.size(), STATS_MAX_CORES));
+    double alpha = std::min(1.0, config.interval_ms / 1000.0);
+    utilization.resize(num_cores, 0.0);
+    std::vector<StatsCore> cores(num_cores);
+    for (uint32_t i = 0; i < num_cores; i++) {
+        const CoreOccupant& occupant = occupants[i];
+        bool busy = occupant.pid != 0;
+        utilization[i] += alpha * ((busy && !occupant.sleeping ? 1.0 : 0.0) - utilization[i]);
+        cores[i].pid = occupant.pid;
+        cores[i].utilization = static_cast<uint16_t>(utilization[i] * 1000.0 + 0.5);
+        cores[i].sleeping = occupant.sleeping;
+        copyName(cores[i].process, occupant.name);
+    }
+
+    // Running first, then waiting, then finished
+    std::vector<StatsProcess> rows = std::move(running);
+    rows.insert(rows.end(), waiting.begin(), waiting.end());
+    rows.insert(rows.end(), history.begin(), history.end());
+    uint32_t count = static_cast<uint32_t>(std::min<size_t>(rows.size(), STATS_MAX_PROCESSES));
+
+    StatsHeader& header = segment.header;
+    uint64_t sequence = header.sequence.load(std::memory_order_relaxed);
+    header.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    header.updated_ms = nowMs();
+    header.cycle = sample.cycle;
+    header.num_cores = num_cores;
+    header.process_count = count;
+    header.queue_depth = sample.queue_depth;
+    header.running = sample.running;
+    header.finished = sample.finished;
+    header.instructions = sample.instructions;
+    header.dispatches = sample.dispatches;
+    header.preemptions = sample.preemptions;
+    std::memcpy(segment.cores, cores.data(), num_cores * sizeof(StatsCore));
+    std::memcpy(segment.processes, rows.data(), count * sizeof(StatsProcess));
+
+    header.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+// ---------------------------------------------------------------------------
+// emu-top
+
+namespace {
+    struct StatsSnapshot {
+        uint64_t writer_pid, updated_ms, cycle, finished, instructions, dispatches, preemptions;
+        uint32_t num_cores, process_count, queue_depth, running;
+        std::vector<StatsCore> cores;
+        std::vector<StatsProcess> processes;
+    };
+
+    // Seqlock read: retry while the writer is mid-update
+    bool readSnapshot(const StatsSegment& segment, StatsSnapshot& out) {
+        const StatsHeader& header = segment.header;
+        for (int attempt = 0; attempt < 1000; attempt++) {
+            uint64_t before = header.sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            out.writer_pid = header.writer_pid;
+            out.updated_ms = header.updated_ms;
+            out.cycle = header.cycle;
+            out.finished = header.finished;
+            out.instructions = header.instructions;
+            out.dispatches = header.dispatches;
+            out.preemptions = header.preemptions;
+            out.num_cores = std::min(header.num_cores, STATS_MAX_CORES);
+            out.process_count = std::min(header.process_count, STATS_MAX_PROCESSES);
+            out.queue_depth = header.queue_depth;
+            out.running = header.running;
+            out.cores.assign(segment.cores, segment.cores + out.num_cores);
+            out.processes.assign(segment.processes, segment.processes + out.process_count);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (header.sequence.load(std::memory_order_relaxed) == before) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const char* stateName(const StatsProcess& p) {
+        if (p.state == static_cast<uint8_t>(ProcessState::Finished)) return "done";
+        if (p.state == static_cast<uint8_t>(ProcessState::Blocked)) return "io";
+        if (p.sleeping) return "sleep";
+        return p.state == static_cast<uint8_t>(ProcessState::Running) ? "run" : "wait";
+    }
+}
+
+int runEmuTop(const std::string& name, int refreshes) {
+    SharedMemory memory;
+    if (!memory.open(name, sizeof(StatsSegment))) {
+        std::cerr << "Could not open stats segment '" << name << "'. Is the emulator running with "
+            << "stats-interval-ms set?" << std::endl;
+        return 1;
+    }
+    const auto* segment = static_cast<const StatsSegment*>(memory.data());
+    if (segment->header.magic != STATS_MAGIC || segment->header.version != STATS_VERSION) {
+        std::cerr << "Segment '" << name << "' has an unknown layout." << std::endl;
+        return 1;
+    }
+
+    StatsSnapshot snap;
+    for (int i = 0; refreshes == 0 || i < refreshes; i++) {
+        if (i > 0) {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+        if (!readSnapshot(*segment, snap)) continue;
+
+        if (refreshes != 1) {
+            std::cout << "\x1b[H\x1b[2J";
+        }
+        uint64_t age = nowMs() - std::min(nowMs(), snap.updated_ms);
+        std::cout << "emu-top   segment " << name << "   emulator pid " << snap.writer_pid
+            << "   cycle " << snap.cycle << "   updated " << age << " ms ago"
+            << (age > 5000 ? " (stale)" : "") << std::endl;
+        std::cout << "Cores: " << snap.num_cores << "   Running: " << snap.running
+            << "   Queue: " << snap.queue_depth << "   Finished: " << snap.finished
+            << "   Instructions: " << snap.instructions << "   Dispatches: " << snap.dispatches
+            << "   Preemptions: " << snap.preemptions << std::endl;
+
+        std::cout << std::endl << "CORE     PID   UTIL  PROCESS" << std::endl;
+        for (uint32_t c = 0; c < snap.num_cores; c++) {
+            const StatsCore& core = snap.cores[c];
+            std::cout << std::setw(4) << c << std::setw(8);
+            if (core.pid) std::cout << core.pid; else std::cout << "-";
+            std::cout << std::setw(6) << (core.utilization + 5) / 10 << "%  "
+                << core.process << (core.sleeping ? " (sleeping)" : "") << std::endl;
+        }
+
+        std::cout << std::endl << "    PID  NAME                      STATE  CORE      PROGRESS" << std::endl;
+        size_t shown = std::min<size_t>(snap.processes.size(), 20);
+        for (size_t p = 0; p < shown; p++) {
+            const StatsProcess& row = snap.processes[p];
+            std::cout << std::setw(7) << row.pid << "  " << std::left << std::setw(24) << row.name
+                << "  " << std::setw(5) << stateName(row) << std::right << std::setw(6);
+            if (row.core >= 0) std::cout << row.core; else std::cout << "-";
+            std::cout << std::setw(8) << row.done << " / " << row.total << std::endl;
+        }
+        if (snap.processes.size() > shown) {
+            std::cout << "  ... " << snap.processes.size() - shown << " more" << std::endl;
+        }
+        std::cout << std::flush;
+    }
+    return 0;
+}
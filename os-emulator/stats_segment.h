@@ -0,0 +1,115 @@
+#ifndef STATS_SEGMENT_H
+#define STATS_SEGMENT_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+class Scheduler;
+
+struct StatsConfig {
+    uint64_t interval_ms = 0;               // 0 disables publishing
+    std::string segment = "csopesy-stats";  // shm name (POSIX "/name", Windows "Local\name")
+};
+
+// Segment layout. Everything is fixed-size and position-independent so any
+// process can map it. The writer bumps `sequence` to an odd value before
+// updating and to the next even value after (a seqlock); readers copy the
+// segment and retry if the sequence was odd or changed, so they never block
+// the emulator and the emulator never waits for them.
+constexpr uint32_t STATS_MAGIC = 0x53545343;    // "CSTS"
+constexpr uint32_t STATS_VERSION = 1;
+constexpr uint32_t STATS_MAX_CORES = 256;
+constexpr uint32_t STATS_MAX_PROCESSES = 1024;
+constexpr size_t STATS_NAME_LENGTH = 24;
+
+struct StatsHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t core_capacity;
+    uint32_t process_capacity;
+    std::atomic<uint64_t> sequence;
+    uint64_t writer_pid;
+    uint64_t updated_ms;        // system clock, ms since epoch
+    uint64_t cycle;
+    uint32_t num_cores;
+    uint32_t process_count;     // valid entries in the process table
+    uint32_t queue_depth;
+    uint32_t running;
+    uint64_t finished;
+    uint64_t instructions;
+    uint64_t dispatches;
+    uint64_t preemptions;
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "seqlock needs a lock-free counter");
+
+struct StatsCore {
+    uint32_t pid;                   // 0 when idle
+    uint16_t utilization;           // per mille, smoothed over about a second
+    uint16_t sleeping;              // occupant is in SLEEP
+    char process[STATS_NAME_LENGTH];
+};
+
+struct StatsProcess {
+    uint32_t pid;
+    int16_t core;                   // -1 when not on a core
+    uint8_t state;                  // ProcessState
+    uint8_t sleeping;
+    uint32_t done;
+    uint32_t total;
+    char name[STATS_NAME_LENGTH];
+};
+
+struct StatsSegment {
+    StatsHeader header;
+    StatsCore cores[STATS_MAX_CORES];
+    StatsProcess processes[STATS_MAX_PROCESSES];
+};
+
+// Creates or opens a named shared-memory region of a fixed size
+class SharedMemory {
+public:
+    ~SharedMemory() { close(); }
+
+    bool create(const std::string& name, size_t size);
+    bool open(const std::string& name, size_t size);
+    void close();
+    void* data() const { return address; }
+
+private:
+    void* address = nullptr;
+    size_t size = 0;
+    std::string name;
+    bool owner = false;
+#ifdef _WIN32
+    void* handle = nullptr;
+#endif
+};
+
+// Emulator side: copies scheduler state into the segment every interval
+class StatsPublisher {
+public:
+    ~StatsPublisher() { stop(); }
+
+    bool start(Scheduler* scheduler, const StatsConfig& config);
+    void stop();
+
+private:
+    Scheduler* scheduler = nullptr;
+    StatsConfig config;
+    SharedMemory memory;
+    std::thread thread;
+    std::atomic<bool> running{ false };
+    std::atomic<bool> stop_requested{ false };
+    std::vector<double> utilization;
+
+    void run();
+    void publish(StatsSegment& segment);
+};
+
+// Reader side: "os-emulator --emu-top [segment] [refreshes]"
+int runEmuTop(const std::string& segment, int refreshes = 0);
+
+#endif // STATS_SEGMENT_H
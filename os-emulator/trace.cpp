@@ -0,0 +1,372 @@
+#include "trace.h"
+#include "program.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <cstring>
+
+extern std::atomic<uint64_t> cpu_cycles;
+
+std::atomic<bool> trace_enabled{ false };
+
+namespace {
+    struct TraceFileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t event_size;
+    };
+    const char TRACE_MAGIC[8] = { 'C', 'S', 'T', 'R', 'A', 'C', 'E', '1' };
+
+    uint64_t steadyNanos() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Marks the calling thread's ring retired when the thread exits, so the
+    // drain thread can free it once it has been emptied
+    template <class Ring>
+    struct RingHandle {
+        Ring* ring = nullptr;
+        ~RingHandle() {
+            if (ring) ring->retired.store(true, std::memory_order_release);
+        }
+    };
+}
+
+Tracer& Tracer::instance() {
+    // Never destroyed: worker threads may still hold a ring at exit
+    static Tracer* tracer = new Tracer();
+    return *tracer;
+}
+
+bool Tracer::start(const std::string& file) {
+    if (trace_enabled) return false;
+
+    out.open(file, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) return false;
+    TraceFileHeader header;
+    std::memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = 1;
+    header.event_size = sizeof(TraceEvent);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    path = file;
+    dropped = 0;
+    written = 0;
+    start_ns = steadyNanos();
+    {
+        // Discard anything emitted after the previous session's final drain
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        for (auto& ring : rings) {
+            ring->tail.store(ring->head.load(std::memory_order_acquire), std::memory_order_release);
+        }
+    }
+    stop_requested = false;
+    drain_thread = std::thread(&Tracer::drain, this);
+    trace_enabled = true;
+    return true;
+}
+
+void Tracer::stop() {
+    if (!trace_enabled) return;
+    trace_enabled = false;
+    stop_requested = true;
+    if (drain_thread.joinable()) {
+        drain_thread.join();
+    }
+    out.close();
+}
+
+Tracer::Ring* Tracer::threadRing() {
+    static thread_local RingHandle<Ring> handle;
+    if (!handle.ring) {
+        auto ring = std::make_unique<Ring>();
+        handle.ring = ring.get();
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        rings.push_back(std::move(ring));
+    }
+    return handle.ring;
+}
+
+void Tracer::emit(TraceEventType type, int core, uint32_t pid, uint8_t opcode) {
+    Ring* ring = threadRing();
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= RING_SIZE) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    TraceEvent& event = ring->events[head & (RING_SIZE - 1)];
+    event.cycle = cpu_cycles.load(std::memory_order_relaxed);
+    event.time_ns = steadyNanos() - start_ns;
+    event.pid = pid;
+    event.core = core < 0 ? TRACE_NO_CORE : static_cast<uint16_t>(core);
+    event.type = type;
+    event.opcode = opcode;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void Tracer::drainOnce() {
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    for (auto it = rings.begin(); it != rings.end();) {
+        Ring& ring = **it;
+        bool retired = ring.retired.load(std::memory_order_acquire);
+        uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+        uint64_t head = ring.head.load(std::memory_order_acquire);
+
+        // At most two contiguous pieces: up to the end of the array, then the wrap
+        while (tail < head) {
+            size_t index = tail & (RING_SIZE - 1);
+            size_t count = std::min<uint64_t>(head - tail, RING_SIZE - index);
+            out.write(reinterpret_cast<const char*>(&ring.events[index]), count * sizeof(TraceEvent));
+            tail += count;
+            written += count;
+        }
+        ring.tail.store(tail, std::memory_order_release);
+
+        if (retired) {
+            it = rings.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+void Tracer::drain() {
+    while (!stop_requested) {
+        drainOnce();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    drainOnce();
+    out.flush();
+}
+
+// ---------------------------------------------------------------------------
+// Offline analyzer
+
+namespace {
+    const char* opcodeName(uint8_t code) {
+        static const char* names[] = {
+            "NOP", "PRINT", "DECLARE", "ADD", "ADD(v,v)", "SUBTRACT", "SUBTRACT(v,v)",
+            "SUBTRACT(i,v)", "SLEEP", "FOR", "ENDFOR", "FOR-ADD", "FOR-SUBTRACT",
+            "FOR-DECLARE", "DECLARE+ADD", "READ", "WRITE"
+        };
+        return code < std::size(names) ? names[code] : "?";
+    }
+
+    struct Segment {
+        uint64_t begin_ns;
+        uint64_t end_ns;
+        uint32_t pid;
+    };
+
+    struct ProcessTimes {
+        bool arrived = false;
+        bool dispatched = false;
+        bool finished = false;
+        uint64_t arrival_ns = 0;
+        uint64_t first_dispatch_ns = 0;
+        uint64_t finish_ns = 0;
+        uint64_t arrival_cycle = 0;
+        uint64_t finish_cycle = 0;
+        uint64_t running_ns = 0;
+    };
+
+    void printDistribution(const std::string& label, std::vector<double> values, const char* unit) {
+        std::cout << "  " << std::left << std::setw(12) << label << std::right;
+        if (values.empty()) {
+            std::cout << "(no samples)" << std::endl;
+            return;
+        }
+        std::sort(values.begin(), values.end());
+        double sum = 0;
+        for (double v : values) sum += v;
+        auto pct = [&](double p) { return values[static_cast<size_t>(p * (values.size() - 1))]; };
+        std::cout << std::fixed << std::setprecision(2)
+            << "n=" << values.size()
+            << "  min " << values.front()
+            << "  avg " << sum / values.size()
+            << "  p50 " << pct(0.50)
+            << "  p95 " << pct(0.95)
+            << "  max " << values.back() << " " << unit << std::endl;
+    }
+
+    char pidSymbol(size_t index) {
+        static const char symbols[] =
+            "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+        return index < sizeof(symbols) - 1 ? symbols[index] : '#';
+    }
+}
+
+int analyzeTrace(const std::string& path, int width) {
+    width = std::max(width, 8);
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Error: Could not open trace file: " << path << std::endl;
+        return 1;
+    }
+    TraceFileHeader header;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || std::memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0
+        || header.event_size != sizeof(TraceEvent)) {
+        std::cerr << "Error: " << path << " is not a trace file." << std::endl;
+        return 1;
+    }
+
+    std::vector<TraceEvent> events;
+    TraceEvent event;
+    while (in.read(reinterpret_cast<char*>(&event), sizeof(event))) {
+        events.push_back(event);
+    }
+    if (events.empty()) {
+        std::cout << "Trace is empty." << std::endl;
+        return 0;
+    }
+    // Rings drain independently; restore global order
+    std::stable_sort(events.begin(), events.end(),
+        [](const TraceEvent& a, const TraceEvent& b) { return a.time_ns < b.time_ns; });
+
+    int num_cores = 0;
+    uint64_t counts[7] = {};
+    std::map<uint8_t, uint64_t> opcodes;
+    std::map<uint32_t, ProcessTimes> processes;
+    std::map<uint32_t, size_t> symbols;     // pid -> legend index, by first dispatch
+    std::vector<Segment> open;
+    std::vector<std::vector<Segment>> segments;
+
+    auto closeSegment = [&](const TraceEvent& e) {
+        if (e.core >= open.size() || open[e.core].pid != e.pid) return;
+        Segment s = open[e.core];
+        s.end_ns = e.time_ns;
+        segments[e.core].push_back(s);
+        processes[e.pid].running_ns += s.end_ns - s.begin_ns;
+        open[e.core].pid = 0;
+    };
+
+    for (const TraceEvent& e : events) {
+        if (static_cast<size_t>(e.type) < std::size(counts)) {
+            counts[static_cast<size_t>(e.type)]++;
+        }
+        if (e.core != TRACE_NO_CORE && e.core + 1 > num_cores) {
+            num_cores = e.core + 1;
+            open.resize(num_cores, { 0, 0, 0 });
+            segments.resize(num_cores);
+        }
+
+        ProcessTimes& times = processes[e.pid];
+        switch (e.type) {
+        case TraceEventType::Arrive:
+            times.arrived = true;
+            times.arrival_ns = e.time_ns;
+            times.arrival_cycle = e.cycle;
+            break;
+        case TraceEventType::Dispatch:
+            if (!times.dispatched) {
+                times.dispatched = true;
+                times.first_dispatch_ns = e.time_ns;
+            }
+            // A corrupt or truncated file may carry a dispatch without a core
+            if (e.core >= open.size()) break;
+            open[e.core] = { e.time_ns, 0, e.pid };
+            symbols.emplace(e.pid, symbols.size());
+            break;
+        case TraceEventType::Execute:
+            opcodes[e.opcode]++;
+            break;
+        case TraceEventType::Preempt:
+        case TraceEventType::Block:
+            closeSegment(e);
+            break;
+        case TraceEventType::Finish:
+            closeSegment(e);
+            times.finished = true;
+            times.finish_ns = e.time_ns;
+            times.finish_cycle = e.cycle;
+            break;
+        default:
+            break;
+        }
+    }
+
+    uint64_t end_ns = events.back().time_ns;
+    uint64_t begin_ns = events.front().time_ns;
+    for (int core = 0; core < num_cores; core++) {
+        if (open[core].pid != 0) {
+            segments[core].push_back({ open[core].begin_ns, end_ns, open[core].pid });
+        }
+    }
+    uint64_t span_ns = std::max<uint64_t>(end_ns - begin_ns, 1);
+
+    std::cout << "--------------------------------------" << std::endl;
+    std::cout << "Trace: " << path << std::endl;
+    std::cout << "Events: " << events.size() << "     Span: " << std::fixed << std::setprecision(3)
+        << span_ns / 1e9 << " s     Cycles: " << events.front().cycle << " - " << events.back().cycle << std::endl;
+    std::cout << "Arrivals: " << counts[0] << "     Dispatches: " << counts[1]
+        << "     Instructions: " << counts[2] << "     Preemptions: " << counts[3]
+        << "     Sleeps: " << counts[4] << "     I/O blocks: " << counts[6]
+        << "     Finished: " << counts[5] << std::endl;
+
+    // Gantt chart: one row per core, each column shows the process on that
+    // core at the column's midpoint
+    std::cout << "--------------------------------------" << std::endl;
+    std::cout << "Timeline (" << std::setprecision(2) << span_ns / 1e6 / width << " ms per column)" << std::endl;
+    for (int core = 0; core < num_cores; core++) {
+        std::string row(width, '.');
+        uint64_t busy_ns = 0;
+        for (const Segment& s : segments[core]) {
+            busy_ns += s.end_ns - s.begin_ns;
+            for (int col = 0; col < width; col++) {
+                uint64_t mid = begin_ns + (2 * col + 1) * span_ns / (2 * width);
+                if (mid >= s.begin_ns && mid < s.end_ns) {
+                    row[col] = pidSymbol(symbols[s.pid]);
+                }
+            }
+        }
+        std::cout << "Core " << std::setw(2) << core << " |" << row << "| "
+            << std::setprecision(0) << 100.0 * busy_ns / span_ns << "%" << std::endl;
+    }
+    std::cout << "Legend:";
+    size_t shown = 0;
+    for (const auto& [pid, index] : symbols) {
+        if (index >= 62) continue;
+        if (shown++ == 24) {
+            std::cout << " ...";
+            break;
+        }
+        std::cout << " " << pidSymbol(index) << "=pid" << pid;
+    }
+    std::cout << std::endl;
+
+    // Latency summaries over processes whose arrival was traced
+    std::vector<double> response, turnaround, waiting, turnaround_cycles;
+    for (const auto& [pid, t] : processes) {
+        if (!t.arrived) continue;
+        if (t.dispatched) {
+            response.push_back((t.first_dispatch_ns - t.arrival_ns) / 1e6);
+        }
+        if (t.finished) {
+            uint64_t total = t.finish_ns - t.arrival_ns;
+            turnaround.push_back(total / 1e6);
+            waiting.push_back((total - std::min(total, t.running_ns)) / 1e6);
+            turnaround_cycles.push_back(static_cast<double>(t.finish_cycle - t.arrival_cycle));
+        }
+    }
+    std::cout << "--------------------------------------" << std::endl;
+    std::cout << "Latency" << std::endl;
+    printDistribution("response", response, "ms");
+    printDistribution("waiting", waiting, "ms");
+    printDistribution("turnaround", turnaround, "ms");
+    printDistribution("", turnaround_cycles, "cycles");
+
+    if (!opcodes.empty()) {
+        std::cout << "--------------------------------------" << std::endl;
+        std::cout << "Instructions by opcode" << std::endl;
+        for (const auto& [code, n] : opcodes) {
+            std::cout << "  " << std::left << std::setw(16) << opcodeName(code) << std::right << n << std::endl;
+        }
+    }
+    std::cout << "--------------------------------------" << std::endl;
+    return 0;
+}
@@ -0,0 +1,79 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <fstream>
+#include <cstdint>
+
+enum class TraceEventType : uint8_t { Arrive, Dispatch, Execute, Preempt, Sleep, Finish, Block };
+
+// Fixed-size record written to the trace file as-is
+struct TraceEvent {
+    uint64_t cycle;
+    uint64_t time_ns;       // steady_clock, relative to trace start
+    uint32_t pid;
+    uint16_t core;          // TRACE_NO_CORE for events not tied to a core
+    TraceEventType type;
+    uint8_t opcode;         // OpCode for Execute events
+};
+static_assert(sizeof(TraceEvent) == 24, "TraceEvent must stay 24 bytes");
+
+constexpr uint16_t TRACE_NO_CORE = 0xFFFF;
+
+extern std::atomic<bool> trace_enabled;
+
+// Collects events into one single-producer ring per emitting thread (one
+// per core in the default execution mode) and drains them to a binary file
+// from a background thread. Producers never lock; a full ring drops events.
+class Tracer {
+public:
+    static Tracer& instance();
+
+    bool start(const std::string& path);
+    void stop();
+    void emit(TraceEventType type, int core, uint32_t pid, uint8_t opcode);
+    uint64_t getDroppedCount() const { return dropped; }
+    uint64_t getWrittenCount() const { return written; }
+    const std::string& getPath() const { return path; }
+
+private:
+    static constexpr size_t RING_SIZE = 1 << 16;
+
+    struct Ring {
+        std::unique_ptr<TraceEvent[]> events{ new TraceEvent[RING_SIZE] };
+        std::atomic<uint64_t> head{ 0 };    // written by the owning thread
+        std::atomic<uint64_t> tail{ 0 };    // written by the drain thread
+        std::atomic<bool> retired{ false }; // owning thread has exited
+    };
+
+    std::mutex rings_mutex;
+    std::vector<std::unique_ptr<Ring>> rings;
+    std::thread drain_thread;
+    std::atomic<bool> stop_requested{ false };
+    std::atomic<uint64_t> dropped{ 0 };
+    std::atomic<uint64_t> written{ 0 };
+    std::ofstream out;
+    std::string path;
+    uint64_t start_ns = 0;
+
+    Ring* threadRing();
+    void drain();
+    void drainOnce();
+};
+
+// Hot-path hook: a single relaxed load and branch while tracing is off
+inline void traceEvent(TraceEventType type, int core, uint32_t pid, uint8_t opcode = 0) {
+    if (trace_enabled.load(std::memory_order_relaxed)) {
+        Tracer::instance().emit(type, core, pid, opcode);
+    }
+}
+
+// Offline analysis: per-core Gantt timeline and latency summary
+int analyzeTrace(const std::string& path, int width = 72);
+
+#endif // TRACE_H
@@ -0,0 +1,153 @@
+#include "workload.h"
+#include "scheduler.h"
+#include "process.h"
+#include "cycle_clock.h"
+#include "image.h"
+#include <map>
+#include <charconv>
+#include <cstring>
+#include <climits>
+
+namespace {
+    // Consumed pages are dropped in chunks of this size
+    constexpr size_t RELEASE_CHUNK = 64 * 1024 * 1024;
+
+    bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    std::string_view nextToken(const char*& cursor, const char* end) {
+        while (cursor < end && isBlank(*cursor)) cursor++;
+        const char* begin = cursor;
+        while (cursor < end && !isBlank(*cursor)) cursor++;
+        return std::string_view(begin, cursor - begin);
+    }
+
+    bool parseNumber(std::string_view token, uint64_t& value) {
+        auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+        return result.ec == std::errc() && result.ptr == token.data() + token.size();
+    }
+
+    bool parseMix(std::string_view program, InstructionMix& mix) {
+        if (program.empty() || program == "mixed") mix = InstructionMix::Mixed;
+        else if (program == "arithmetic") mix = InstructionMix::Arithmetic;
+        else if (program == "loops") mix = InstructionMix::Loops;
+        else if (program == "io") mix = InstructionMix::IoBound;
+        else return false;
+        return true;
+    }
+}
+
+bool WorkloadReplay::open(const std::string& path) {
+    close();
+    if (!file.open(path)) return false;
+    file.adviseSequential();
+    return true;
+}
+
+void WorkloadReplay::close() {
+    file.close();
+    offset = 0;
+    released = 0;
+    replayed = 0;
+    duplicates = 0;
+    malformed = 0;
+    late = 0;
+    rejected = 0;
+    bytes_read = 0;
+    finished = false;
+}
+
+bool WorkloadReplay::next(WorkloadRecord& record) {
+    const char* base = file.data();
+    const char* end = base + file.size();
+
+    while (offset < file.size()) {
+        const char* line = base + offset;
+        const char* line_end = static_cast<const char*>(std::memchr(line, '\n', end - line));
+        if (!line_end) line_end = end;
+        offset = (line_end - base) + (line_end < end ? 1 : 0);
+        bytes_read.store(offset, std::memory_order_relaxed);
+
+        if (offset - released >= RELEASE_CHUNK) {
+            file.release(released, offset - released);
+            released = offset;
+        }
+
+        const char* cursor = line;
+        std::string_view arrival = nextToken(cursor, line_end);
+        if (arrival.empty() || arrival.front() == '#') continue;
+
+        std::string_view name = nextToken(cursor, line_end);
+        std::string_view instructions = nextToken(cursor, line_end);
+        record.program = nextToken(cursor, line_end);
+        record.name = name;
+        if (name.empty() || !parseNumber(arrival, record.arrival)
+            || !parseNumber(instructions, record.instructions)
+            || record.instructions == 0 || record.instructions > INT_MAX) {
+            malformed++;
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+void WorkloadReplay::run(Scheduler& scheduler, const std::atomic<bool>* stop) {
+    uint64_t start = cpu_cycles;
+    WorkloadRecord record;
+    // Images referenced by the trace, loaded once each
+    std::map<std::string, std::shared_ptr<const Program>, std::less<>> images;
+
+    while (!*stop && next(record)) {
+        InstructionMix mix = InstructionMix::Mixed;
+        std::shared_ptr<const Program> image;
+        if (!parseMix(record.program, mix)) {
+            auto it = images.find(record.program);
+            if (it == images.end()) {
+                std::string error;
+                it = images.emplace(std::string(record.program),
+                    loadProgramImage(std::string(record.program), error)).first;
+            }
+            image = it->second;
+            if (!image) {
+                malformed++;
+                continue;
+            }
+        }
+
+        // Arrivals are relative to the start of the replay, so a trace
+        // reproduces the same spacing whenever it is started
+        uint64_t due = start + record.arrival;
+        while (cpu_cycles < due && !*stop) {
+            cycle_waiters.waitFor(due, stop);
+        }
+        if (*stop) break;
+        if (cpu_cycles > due) {
+            late++;
+        }
+
+        // An image fixes the program, so its length overrides the trace's count
+        Process* p = image ? new Process(std::string(record.name), image)
+            : new Process(std::string(record.name), static_cast<int>(record.instructions), mix);
+        AddResult result = scheduler.submitProcess(p, true, stop);
+        if (result == AddResult::Added) {
+            replayed++;
+            continue;
+        }
+        delete p;
+        (result == AddResult::Exists ? duplicates : rejected)++;
+    }
+    finished = offset >= file.size();
+}
+
+WorkloadStats WorkloadReplay::getStats() const {
+    WorkloadStats stats;
+    stats.replayed = replayed;
+    stats.duplicates = duplicates;
+    stats.malformed = malformed;
+    stats.late = late;
+    stats.rejected = rejected;
+    stats.bytes_read = bytes_read;
+    stats.file_bytes = file.size();
+    stats.finished = finished;
+    return stats;
+}
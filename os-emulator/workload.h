@@ -0,0 +1,66 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include "mapped_file.h"
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <cstdint>
+
+class Scheduler;
+
+// One arrival from a workload trace. The views point into the mapping.
+struct WorkloadRecord {
+    uint64_t arrival = 0;           // cycles after the replay started
+    std::string_view name;
+    uint64_t instructions = 0;
+    std::string_view program;       // optional mix or image path; empty means mixed
+};
+
+struct WorkloadStats {
+    uint64_t replayed = 0;
+    uint64_t duplicates = 0;        // names already present, skipped
+    uint64_t malformed = 0;         // lines that did not parse, skipped
+    uint64_t late = 0;              // admitted after their arrival cycle
+    uint64_t rejected = 0;          // shed by admission control
+    uint64_t bytes_read = 0;
+    uint64_t file_bytes = 0;
+    bool finished = false;
+};
+
+// Replays a text trace of arrivals, one per line:
+//
+//   <arrival-cycle> <name> <instructions> [program]
+//
+// where program is an instruction mix (mixed, arithmetic, loops, io) or the path
+// of a program image (see image.h). Blank lines and lines starting with '#'
+// are ignored. The file is memory-mapped and parsed one line at a time as
+// arrivals fall due, so start-up is instant and memory use does not depend on
+// the trace size. Records are expected in arrival order; one whose cycle has
+// already passed is released immediately.
+class WorkloadReplay {
+public:
+    bool open(const std::string& path);
+    void close();
+
+    // Feeds arrivals to the scheduler until the trace ends or stop is set
+    void run(Scheduler& scheduler, const std::atomic<bool>* stop);
+    WorkloadStats getStats() const;
+
+private:
+    MappedFile file;
+    size_t offset = 0;
+    size_t released = 0;
+
+    std::atomic<uint64_t> replayed{ 0 };
+    std::atomic<uint64_t> duplicates{ 0 };
+    std::atomic<uint64_t> malformed{ 0 };
+    std::atomic<uint64_t> late{ 0 };
+    std::atomic<uint64_t> rejected{ 0 };
+    std::atomic<uint64_t> bytes_read{ 0 };
+    std::atomic<bool> finished{ false };
+
+    bool next(WorkloadRecord& record);
+};
+
+#endif // WORKLOAD_H